@@ -13,11 +13,36 @@
  */
 
 #include <windows.h>
+#include <conio.h>
+#include <iomanip>
 #include <iostream>
 #include <fstream>
 #include <vector>
 #include <string>
+#include <string_view>
 #include <sstream>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cctype>
+#include <cerrno>
+#include <climits>
+#include <cstdio>
+#include <condition_variable>
+#include <cstring>
+#include <cmath>
+#include <ctime>
+#include <deque>
+#include <filesystem>
+#include <functional>
+#include <limits>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
 
 using namespace std;
 
@@ -37,217 +62,7332 @@ std::string getExecutableDirectory() {
     return fullPath.substr(0, pos); // Extracts the directory path
 }
 
-const std::string FILENAME = getExecutableDirectory() + "\\todo.txt"; /**< File path relative to the .exe location */
+std::string FILENAME = getExecutableDirectory() + "\\todo.txt"; /**< File path relative to the .exe location */
+
+const std::string CATALOG_FILENAME = getExecutableDirectory() + "\\todo.catalog"; /**< File path of the catalog of named lists */
+std::string listName = "default"; /**< The selected list; named lists are stored as `todo-NAME.txt` */
 
 /**
  * @struct Task
  * @brief Represents a task in the ToDo list.
  *
- * Each task has a description and a completion status.
+ * Each task has a description and a completion status. Tags are written inline
+ * in the description as `+tag` words; priority and dates are optional.
+ *
+ * Subtasks are stored in preorder: every task is followed by its whole subtree,
+ * so a subtree always occupies a contiguous range of the list.
  */
 struct Task {
     string description; /**< The description of the task. */
     bool completed;     /**< The completion status of the task. */
+    int priority;       /**< The priority from 1 (highest) to 9, or 0 if unset. */
+    string due;         /**< The due date as YYYY-MM-DD, empty if unset. */
+    string created;     /**< The creation date as YYYY-MM-DD, empty for tasks saved by older versions. */
+    unsigned id;        /**< The stable identifier of the task, unique within the list. */
+    unsigned parent;    /**< The ID of the parent task, or 0 for a top-level task. */
+    unsigned depth;     /**< The nesting level, 0 for top-level tasks; derived from the layout, not saved. */
+    vector<unsigned> after;  /**< The IDs of the tasks this task is blocked by. */
+    vector<unsigned> blocks; /**< The IDs of the tasks blocked by this task. */
+    unsigned blockers;       /**< The number of tasks in `after` that are not completed yet. */
+    string every;       /**< The recurrence interval such as `1d`, `2w`, `1m` or `1y`, empty for one-off tasks. */
+    string since;       /**< The first occurrence of a recurring task, from which all occurrences are computed. */
+    long long spent;    /**< The total tracked time in seconds, excluding a running timer. */
+    time_t started;     /**< The start time of the running timer, or 0 if it is not running. */
 
     /**
      * @brief Constructs a Task.
      * @param desc The task description.
      * @param comp The completion status, default is false.
      */
-    Task(const string& desc, bool comp = false) : description(desc), completed(comp) {}
+    Task(const string& desc, bool comp = false) : description(desc), completed(comp), priority(0), id(0), parent(0), depth(0), blockers(0), spent(0), started(0) {}
 };
 
 /**
- * @brief Lists all tasks.
+ * @brief The kinds of change the list operations apply to a task.
+ */
+enum class Change { Added, Completed, Rescheduled, Removed };
+
+/**
+ * @brief Propagates a task change to the data kept alongside the task file.
  *
- * Iterates through the tasks vector and displays each task's description
- * and its completion status.
- * @param tasks The vector of tasks to be listed.
+ * Called by addTask(), markDone() and removeTask() for every task they change.
+ * @param change The kind of change.
+ * @param task The task after the change (before it, for removals).
  */
-void listTasks(vector<Task>& tasks) {
-    if (tasks.empty()) {
-        cout << "No tasks available." << endl;
-        return;
+void recordChange(Change change, const Task& task);
+
+/**
+ * @brief Propagates the removal of all tasks to the data kept alongside the task file.
+ *
+ * Called by resetTasks().
+ */
+void recordReset();
+
+/**
+ * @brief Loads the files kept alongside the task file that saveTasks() rewrites.
+ *
+ * Called by saveTasks() before the task file is written.
+ */
+void prepareSidecars();
+
+/**
+ * @brief Writes the files kept alongside the task file.
+ *
+ * Called by saveTasks() after the task file is written.
+ * @param tasks The tasks that were saved.
+ * @param durable If true, the event journal is flushed to disk as well.
+ */
+void saveSidecars(const vector<Task>& tasks, bool durable = false);
+
+/**
+ * @brief Flushes a file that was written and closed to disk.
+ * @param path The file.
+ * @return false if the file could not be opened or flushed.
+ */
+bool flushToDisk(const string& path) {
+    HANDLE handle = CreateFileA(path.c_str(), GENERIC_WRITE, FILE_SHARE_READ | FILE_SHARE_WRITE, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (handle == INVALID_HANDLE_VALUE) return false;
+    bool flushed = FlushFileBuffers(handle);
+    CloseHandle(handle);
+    return flushed;
+}
+
+/**
+ * @brief Records imported tasks in the event journal.
+ *
+ * Called by importTasks(), which appends to the task file without saveTasks().
+ * @param count The number of tasks imported.
+ */
+void recordImport(long long count);
+
+/**
+ * @brief Converts a string to lower case.
+ * @param str The input string.
+ * @return A lower-case copy of the input string.
+ */
+string toLower(const string& str) {
+    string result = str;
+    for (char& c : result) {
+        c = static_cast<char>(tolower(static_cast<unsigned char>(c)));
     }
+    return result;
+}
 
-    for (size_t i = 0; i < tasks.size(); ++i) {
-        cout << i + 1 << ". [" << (tasks[i].completed ? "X" : " ") << "] " << tasks[i].description << endl;
+/**
+ * @brief Returns the current local date.
+ * @return std::string Today's date in YYYY-MM-DD format.
+ */
+string today() {
+    time_t now = time(nullptr);
+    tm local = *localtime(&now);
+    char buf[11];
+    strftime(buf, sizeof(buf), "%Y-%m-%d", &local);
+    return buf;
+}
+
+/**
+ * @brief Checks whether a string is a date in YYYY-MM-DD format.
+ * @param str The string to check.
+ * @return true if the string has the shape of a YYYY-MM-DD date.
+ */
+bool isDate(const string& str) {
+    if (str.size() != 10 || str[4] != '-' || str[7] != '-') {
+        return false;
+    }
+    for (size_t i = 0; i < str.size(); ++i) {
+        if (i != 4 && i != 7 && !isdigit(static_cast<unsigned char>(str[i]))) {
+            return false;
+        }
     }
+    return true;
 }
 
 /**
- * @brief Adds a new task.
- *
- * Creates a new task with the given description and adds it to the tasks list.
- * @param tasks The vector of tasks.
- * @param task The description of the task to be added.
+ * @brief Converts a YYYY-MM-DD date to a day number.
+ * @param date The date.
+ * @return The number of days since 1970-01-01.
  */
-void addTask(vector<Task>& tasks, const string& task) {
-    tasks.push_back(Task(task));
+long dayNumber(const string& date) {
+    int y = atoi(date.substr(0, 4).c_str());
+    unsigned m = atoi(date.substr(5, 2).c_str());
+    unsigned d = atoi(date.substr(8, 2).c_str());
+    y -= m <= 2;
+    long era = (y >= 0 ? y : y - 399) / 400;
+    unsigned yoe = static_cast<unsigned>(y - era * 400);
+    unsigned doy = (153 * (m + (m > 2 ? -3 : 9)) + 2) / 5 + d - 1;
+    unsigned doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+    return era * 146097 + static_cast<long>(doe) - 719468;
 }
 
 /**
- * @brief Removes a task by index.
+ * @brief Converts a day number back to a date.
+ * @param days The number of days since 1970-01-01.
+ * @return The date in YYYY-MM-DD format.
+ */
+string dateFromDays(long days) {
+    days += 719468;
+    long era = (days >= 0 ? days : days - 146096) / 146097;
+    unsigned doe = static_cast<unsigned>(days - era * 146097);
+    unsigned yoe = (doe - doe / 1460 + doe / 36524 - doe / 146096) / 365;
+    unsigned doy = doe - (365 * yoe + yoe / 4 - yoe / 100);
+    unsigned mp = (5 * doy + 2) / 153;
+    unsigned d = doy - (153 * mp + 2) / 5 + 1;
+    unsigned m = mp < 10 ? mp + 3 : mp - 9;
+    long y = static_cast<long>(yoe) + era * 400 + (m <= 2);
+    char buf[32];
+    snprintf(buf, sizeof(buf), "%04ld-%02u-%02u", y, m, d);
+    return buf;
+}
+
+/**
+ * @brief Parses a recurrence interval.
  *
- * Removes the task at the specified index in the tasks list.
- * @param tasks The vector of tasks.
- * @param index The index of the task to be removed.
+ * Accepts `N` followed by `d`, `w`, `m` or `y`, or one of `daily`, `weekly`,
+ * `monthly` and `yearly`.
+ * @param every The interval text.
+ * @param count Receives the number of units.
+ * @param unit Receives the unit: 'd' for days or 'm' for months (weeks and years are converted).
+ * @return true if the interval is valid.
  */
-void removeTask(vector<Task>& tasks, int index) {
-    if (index >= 1 && index <= tasks.size()) {
-        tasks.erase(tasks.begin() + index - 1);
-    } else {
-        cout << "Invalid task index." << endl;
+bool parseInterval(const string& every, long& count, char& unit) {
+    static const map<string, string> aliases = {{"daily", "1d"}, {"weekly", "1w"}, {"monthly", "1m"}, {"yearly", "1y"}};
+    auto alias = aliases.find(every);
+    const string& text = alias == aliases.end() ? every : alias->second;
+    if (text.size() < 2 || text.find_first_not_of("0123456789") != text.size() - 1) {
+        return false;
     }
+    count = atol(text.c_str());
+    unit = text.back();
+    if (count <= 0 || string("dwmy").find(unit) == string::npos) return false;
+    if (unit == 'w') count *= 7, unit = 'd';
+    if (unit == 'y') count *= 12, unit = 'm';
+    return true;
 }
 
 /**
- * @brief Marks a task as completed.
+ * @brief Returns the k-th occurrence of a recurrence.
  *
- * Sets the completion status of the task at the specified index to true.
- * @param tasks The vector of tasks.
- * @param index The index of the task to be marked as done.
+ * Monthly recurrences keep the day of the anchor date, clamped to the length of
+ * the month, so the 31st becomes the 30th in April.
+ * @param anchor The first occurrence as YYYY-MM-DD.
+ * @param count The number of units between occurrences.
+ * @param unit 'd' for days or 'm' for months.
+ * @param k The occurrence number, 0 for the anchor.
+ * @return The date of the occurrence.
  */
-void markDone(vector<Task>& tasks, int index) {
-    if (index >= 1 && index <= tasks.size()) {
-        tasks[index - 1].completed = true;
-    } else {
-        cout << "Invalid task index." << endl;
+string occurrence(const string& anchor, long count, char unit, long k) {
+    if (unit == 'd') {
+        return dateFromDays(dayNumber(anchor) + k * count);
     }
+    long month = atoi(anchor.substr(0, 4).c_str()) * 12L + atoi(anchor.substr(5, 2).c_str()) - 1 + k * count;
+    char buf[32];
+    snprintf(buf, sizeof(buf), "%04ld-%02ld-01", month / 12, month % 12 + 1);
+    long monthStart = dayNumber(buf);
+    snprintf(buf, sizeof(buf), "%04ld-%02ld-01", (month + 1) / 12, (month + 1) % 12 + 1);
+    long monthLength = dayNumber(buf) - monthStart;
+    long day = min(static_cast<long>(atoi(anchor.substr(8, 2).c_str())), monthLength);
+    return dateFromDays(monthStart + day - 1);
 }
 
 /**
- * @brief Clears all tasks.
+ * @brief Computes the occurrences of a recurrence that fall inside a date window.
  *
- * Removes all tasks from the tasks list.
- * @param tasks The vector of tasks.
+ * The first occurrence in the window is found arithmetically, so the cost only
+ * depends on the number of occurrences returned.
+ * @param anchor The first occurrence as YYYY-MM-DD.
+ * @param every The recurrence interval.
+ * @param from The first date of the window.
+ * @param to The last date of the window.
+ * @param limit The maximum number of occurrences to return.
+ * @return The dates of the occurrences in [from, to].
  */
-void resetTasks(vector<Task>& tasks) {
-    tasks.clear();
+vector<string> occurrencesBetween(const string& anchor, const string& every, const string& from, const string& to,
+                                  size_t limit = string::npos) {
+    vector<string> dates;
+    long count;
+    char unit;
+    if (!parseInterval(every, count, unit) || !isDate(anchor)) return dates;
+    long k = 0;
+    if (from > anchor) {
+        if (unit == 'd') {
+            k = (dayNumber(from) - dayNumber(anchor) + count - 1) / count;
+        } else {
+            long months = (atoi(from.substr(0, 4).c_str()) - atoi(anchor.substr(0, 4).c_str())) * 12L +
+                          atoi(from.substr(5, 2).c_str()) - atoi(anchor.substr(5, 2).c_str());
+            k = max(0L, months / count - 1);
+            while (occurrence(anchor, count, unit, k) < from) ++k;
+        }
+    }
+    for (string date = occurrence(anchor, count, unit, k); date <= to && dates.size() < limit;
+         date = occurrence(anchor, count, unit, ++k)) {
+        dates.push_back(date);
+    }
+    return dates;
 }
 
 /**
- * @brief Trims leading and trailing whitespaces from a string.
+ * @brief Extracts the tags of a task.
  *
- * This function removes any leading and trailing whitespace characters, including
- * spaces, tabs, newlines, and carriage returns, from the input string.
- *
- * @param str The input string to be trimmed.
- * @return A new string with leading and trailing whitespaces removed. If the input string
- *         contains only whitespaces, an empty string is returned.
+ * Tags are the words of the description that start with a `+`, e.g. `+oncall`.
+ * @param task The task to inspect.
+ * @return The lower-case tag names without the leading `+`.
  */
-string trim(const string& str) {
-    size_t first = str.find_first_not_of(" \t\n\r");
-    size_t last = str.find_last_not_of(" \t\n\r");
-    if (first == string::npos || last == string::npos) {
-        return "";
+vector<string> taskTags(const Task& task) {
+    vector<string> tags;
+    stringstream ss(task.description);
+    string word;
+    while (ss >> word) {
+        if (word.size() > 1 && word[0] == '+') {
+            tags.push_back(toLower(word.substr(1)));
+        }
     }
-    return str.substr(first, (last - first + 1));
+    return tags;
 }
 
 /**
- * @brief Loads tasks from a file into the task list.
- *
- * This function reads tasks from a file specified by the `FILENAME` constant.
- * Each task in the file is expected to be stored on a new line in the format:
+ * @brief Splits a description into lower-case words for text search.
  *
- *     <completion_status> <task_description>
+ * Any character that is not alphanumeric separates words, so `+oncall` yields `oncall`.
+ * @param text The text to split.
+ * @return The lower-case words in order of appearance.
+ */
+vector<string> tokenize(const string& text) {
+    vector<string> words;
+    string word;
+    for (char c : text) {
+        if (isalnum(static_cast<unsigned char>(c))) {
+            word += static_cast<char>(tolower(static_cast<unsigned char>(c)));
+        } else if (!word.empty()) {
+            words.push_back(word);
+            word.clear();
+        }
+    }
+    if (!word.empty()) {
+        words.push_back(word);
+    }
+    return words;
+}
+
+/**
+ * @brief Formats a task for display.
+ * @param task The task to format.
+ * @param number The 1-based number shown in front of the task.
+ * @return The display line, e.g. `3. [ ] Fix pager +oncall (priority 1, due 2026-10-20)`.
+ */
+string formatTask(const Task& task, size_t number) {
+    stringstream ss;
+    ss << number << ". [" << (task.completed ? "X" : " ") << "] " << task.description;
+    vector<string> details;
+    if (task.priority > 0) details.push_back("priority " + to_string(task.priority));
+    if (!task.due.empty()) details.push_back("due " + task.due);
+    if (!task.every.empty()) details.push_back(isdigit(static_cast<unsigned char>(task.every[0])) ? "repeats every " + task.every : "repeats " + task.every);
+    if (!task.completed && task.blockers > 0) details.push_back("blocked by " + to_string(task.blockers));
+    if (task.started != 0) details.push_back("timer running");
+    for (size_t i = 0; i < details.size(); ++i) {
+        ss << (i == 0 ? " (" : ", ") << details[i] << (i + 1 == details.size() ? ")" : "");
+    }
+    return ss.str();
+}
+
+/**
+ * @brief The output formats selected with `--json` and `--ndjson`.
+ */
+enum class OutputFormat { Text, Json, Ndjson };
+
+OutputFormat outputFormat = OutputFormat::Text; /**< The output format of this run. */
+
+/**
+ * @class OutputBuffer
+ * @brief A large write buffer in front of standard output.
  *
- * where:
- * - `<completion_status>` is a boolean (0 or 1) indicating whether the task is completed.
- * - `<task_description>` is the string description of the task.
+ * All program output goes through this buffer, so listing many tasks costs a
+ * few large writes instead of one flush per line.
+ */
+class OutputBuffer {
+public:
+    /**
+     * @brief Constructs a buffer that writes to a stream.
+     * @param out The stream written to when the buffer fills up or is flushed.
+     * @param capacity The buffer size in bytes.
+     */
+    explicit OutputBuffer(FILE* out, size_t capacity = 1 << 16) : out(out), buffer(capacity), used(0) {}
+
+    /**
+     * @brief Flushes the remaining output.
+     */
+    ~OutputBuffer() { flush(); }
+
+    /**
+     * @brief Appends bytes to the buffer.
+     * @param data The bytes to append.
+     * @param size The number of bytes.
+     */
+    void write(const char* data, size_t size) {
+        if (used + size > buffer.size()) {
+            flush();
+            if (size > buffer.size()) {
+                failed = failed || fwrite(data, 1, size, out) != size;
+                return;
+            }
+        }
+        memcpy(buffer.data() + used, data, size);
+        used += size;
+    }
+
+    /**
+     * @brief Appends a string to the buffer.
+     * @param text The string to append.
+     */
+    void write(const string& text) { write(text.data(), text.size()); }
+
+    /**
+     * @brief Appends one byte to the buffer.
+     * @param c The byte to append.
+     */
+    void put(char c) {
+        if (used == buffer.size()) flush();
+        buffer[used++] = c;
+    }
+
+    /**
+     * @brief Writes the buffered bytes to the stream.
+     */
+    void flush() {
+        if (used > 0) failed = failed || fwrite(buffer.data(), 1, used, out) != used;
+        used = 0;
+        failed = fflush(out) != 0 || failed;
+    }
+
+    /**
+     * @brief Tells whether every write so far has succeeded.
+     * @return false once a write failed, e.g. because the reader of a pipe went away.
+     */
+    bool good() const { return !failed; }
+
+private:
+    FILE* out;
+    vector<char> buffer;
+    size_t used;
+    bool failed = false;
+};
+
+OutputBuffer output(stdout); /**< The buffered standard output. */
+
+/**
+ * @brief Checks eight bytes at once for characters that JSON strings must escape.
  *
- * Tasks are loaded into the provided vector, clearing any existing tasks before loading.
- * If the file cannot be opened, a message is displayed to the user.
+ * Uses SWAR bit tricks to test every byte of the word for `"`, `\` or a control
+ * character without a per-byte branch.
+ * @param word Eight bytes of input.
+ * @return true if any byte must be escaped.
+ */
+inline bool wordNeedsEscape(uint64_t word) {
+    const uint64_t ones = 0x0101010101010101ULL;
+    const uint64_t highs = 0x8080808080808080ULL;
+    uint64_t quote = word ^ (ones * '"');
+    uint64_t backslash = word ^ (ones * '\\');
+    uint64_t control = (word - ones * 0x20) & ~word;
+    return ((control | ((quote - ones) & ~quote) | ((backslash - ones) & ~backslash)) & highs) != 0;
+}
+
+/**
+ * @brief Writes a JSON string literal to an output buffer.
  *
- * @param tasks The vector of tasks to be populated from the file.
+ * Runs of bytes that need no escaping are found eight bytes at a time and
+ * copied in one piece.
+ * @param data The string bytes (UTF-8).
+ * @param size The number of bytes.
+ * @param buffer The buffer to write to.
  */
-void loadTasksFromFile(vector<Task>& tasks) {
-    ifstream file(FILENAME);
-    if (file.is_open()) {
-        string line;
-        tasks.clear();
-        while (getline(file, line)) {
-            stringstream ss(line);
-            bool completed;
-            string desc;
-            ss >> completed;
-            getline(ss, desc);
-            desc = trim(desc);  // Trim leading/trailing spaces from description
-            tasks.push_back(Task(desc, completed));
+void writeJsonString(const char* data, size_t size, OutputBuffer& buffer = output) {
+    static const char hex[] = "0123456789abcdef";
+    buffer.put('"');
+    size_t run = 0;
+    size_t i = 0;
+    while (i < size) {
+        uint64_t word;
+        if (i + 8 <= size) {
+            memcpy(&word, data + i, 8);
+            if (!wordNeedsEscape(word)) {
+                i += 8;
+                continue;
+            }
         }
-        file.close();
-    } else {
-        cout << "No saved tasks found." << endl;
+        unsigned char c = static_cast<unsigned char>(data[i]);
+        if (c == '"' || c == '\\' || c < 0x20) {
+            buffer.write(data + run, i - run);
+            char escape[6] = {'\\', static_cast<char>(c), 0, 0, 0, 0};
+            size_t length = 2;
+            if (c == '\n') escape[1] = 'n';
+            else if (c == '\r') escape[1] = 'r';
+            else if (c == '\t') escape[1] = 't';
+            else if (c < 0x20) {
+                memcpy(escape, "\\u00", 4);
+                escape[4] = hex[c >> 4];
+                escape[5] = hex[c & 15];
+                length = 6;
+            }
+            buffer.write(escape, length);
+            run = i + 1;
+        }
+        ++i;
     }
+    buffer.write(data + run, size - run);
+    buffer.put('"');
 }
 
 /**
- * @brief Saves tasks to the file.
+ * @class JsonRecord
+ * @brief Streams one flat JSON object to the output buffer.
  *
- * Writes the current tasks to the "todo.txt" file, saving the description and completion status.
- * @param tasks The vector of tasks to be saved.
+ * With `--ndjson` every record is written on its own line; with `--json` the
+ * records of a run form one array. Fields are written as they are added, so no
+ * document is built in memory.
  */
-void saveTasks(const vector<Task>& tasks) {
-    ofstream file(FILENAME);
-    if (file.is_open()) {
-        for (const auto& task : tasks) {
-            file << task.completed << " " << task.description << endl;
+class JsonRecord {
+public:
+    /**
+     * @brief Begins a record.
+     */
+    JsonRecord() : first(true) {
+        if (outputFormat == OutputFormat::Json) output.put(records++ == 0 ? '[' : ',');
+        output.put('{');
+    }
+
+    /**
+     * @brief Ends the record.
+     */
+    ~JsonRecord() {
+        output.put('}');
+        if (outputFormat == OutputFormat::Ndjson) output.put('\n');
+    }
+
+    /**
+     * @brief Adds a string field.
+     * @param name The field name.
+     * @param value The field value.
+     * @return This record.
+     */
+    JsonRecord& field(const char* name, const string& value) {
+        key(name);
+        writeJsonString(value.data(), value.size());
+        return *this;
+    }
+
+    /**
+     * @brief Adds a string field.
+     * @param name The field name.
+     * @param value The field value.
+     * @return This record.
+     */
+    JsonRecord& field(const char* name, const char* value) { return field(name, string(value)); }
+
+    /**
+     * @brief Adds a number field.
+     * @param name The field name.
+     * @param value The field value.
+     * @return This record.
+     */
+    JsonRecord& field(const char* name, long long value) {
+        key(name);
+        output.write(to_string(value));
+        return *this;
+    }
+
+    /**
+     * @brief Adds a boolean field.
+     * @param name The field name.
+     * @param value The field value.
+     * @return This record.
+     */
+    JsonRecord& field(const char* name, bool value) {
+        key(name);
+        output.write(value ? "true" : "false");
+        return *this;
+    }
+
+    /**
+     * @brief Adds an array of strings.
+     * @param name The field name.
+     * @param values The array elements.
+     * @return This record.
+     */
+    JsonRecord& field(const char* name, const vector<string>& values) {
+        key(name);
+        output.put('[');
+        for (size_t i = 0; i < values.size(); ++i) {
+            if (i > 0) output.put(',');
+            writeJsonString(values[i].data(), values[i].size());
         }
-        file.close();
+        output.put(']');
+        return *this;
     }
-}
+
+    /**
+     * @brief Adds an array of task IDs.
+     * @param name The field name.
+     * @param values The array elements.
+     * @return This record.
+     */
+    JsonRecord& field(const char* name, const vector<unsigned>& values) {
+        key(name);
+        output.put('[');
+        for (size_t i = 0; i < values.size(); ++i) {
+            if (i > 0) output.put(',');
+            output.write(to_string(values[i]));
+        }
+        output.put(']');
+        return *this;
+    }
+
+    /**
+     * @brief Ends the JSON array of a `--json` run.
+     */
+    static void finish() {
+        if (outputFormat == OutputFormat::Json) output.write(records == 0 ? "[]\n" : "]\n");
+    }
+
+private:
+    bool first;
+    static size_t records;
+
+    void key(const char* name) {
+        if (!first) output.put(',');
+        first = false;
+        writeJsonString(name, strlen(name));
+        output.put(':');
+    }
+};
+
+size_t JsonRecord::records = 0;
 
 /**
- * @brief Main entry point of the ToDo application.
+ * @class ConsoleBuffer
+ * @brief The stream buffer installed behind `cout`.
  *
- * Handles command-line arguments to execute the appropriate task-related functions.
- * @param argc The number of command-line arguments.
- * @param argv The array of command-line arguments.
- * @return An integer status code (1 for invalid input, 0 for success).
+ * In text mode it forwards everything to the output buffer. In the JSON modes
+ * each line printed through `cout` becomes a `{"message": ...}` record, so
+ * every command produces valid JSON.
  */
-int main(int argc, char* argv[]) {
-    vector<Task> tasks;
+class ConsoleBuffer : public streambuf {
+protected:
+    int overflow(int c) override {
+        if (c != EOF) put(static_cast<char>(c));
+        return c;
+    }
 
-    // Load tasks from the file at the beginning
-    loadTasksFromFile(tasks);
+    streamsize xsputn(const char* s, streamsize n) override {
+        if (outputFormat == OutputFormat::Text) {
+            output.write(s, static_cast<size_t>(n));
+        } else {
+            for (streamsize i = 0; i < n; ++i) put(s[i]);
+        }
+        return n;
+    }
 
-    if (argc < 2) {
-        cout << "Usage: todo [COMMAND] [ARGUMENTS]" << endl;
-        return 1;
+public:
+    /**
+     * @brief Emits a pending partial line as a message record.
+     */
+    void finishLine() {
+        if (!line.empty()) put('\n');
     }
 
-    string command = argv[1];
-    string task;
+private:
+    string line;
 
-    for (int i = 2; i < argc; ++i) {
-        task += argv[i];
-        if (i < argc - 1) task += " "; // Add space between arguments
+    void put(char c) {
+        if (outputFormat == OutputFormat::Text) {
+            output.put(c);
+        } else if (c != '\n') {
+            line += c;
+        } else {
+            JsonRecord().field("message", line);
+            line.clear();
+        }
     }
+};
 
-    if (command == "list") {
-        listTasks(tasks);
-    } else if (command == "add" && argc > 2) {
-        addTask(tasks, task);
-        saveTasks(tasks);
-        listTasks(tasks);
-    } else if (command == "remove" && argc > 2) {
-        int index = stoi(task);
-        removeTask(tasks, index);
-        saveTasks(tasks);
-        listTasks(tasks);
-    } else if (command == "done" && argc > 2) {
-        int index = stoi(task);
-        markDone(tasks, index);
-        saveTasks(tasks);
-        listTasks(tasks);
-    } else if (command == "reset") {
-        resetTasks(tasks);
-        saveTasks(tasks);
-        cout << "All tasks reset." << endl;
-    } else {
-        cout << "Invalid command." << endl;
+/**
+ * @class OutputSession
+ * @brief Routes `cout` through the output buffer for the lifetime of the object.
+ */
+class OutputSession {
+public:
+    /**
+     * @brief Installs the console buffer behind `cout`.
+     * @param format The output format of this run.
+     */
+    explicit OutputSession(OutputFormat format) {
+        outputFormat = format;
+        previous = cout.rdbuf(&console);
     }
 
-    return 0;
+    /**
+     * @brief Completes the output, flushes it and restores `cout`.
+     */
+    ~OutputSession() {
+        console.finishLine();
+        JsonRecord::finish();
+        output.flush();
+        cout.rdbuf(previous);
+    }
+
+private:
+    ConsoleBuffer console;
+    streambuf* previous;
+};
+
+/**
+ * @brief Prints a task in the selected output format.
+ * @param task The task to print.
+ * @param number The 1-based list number of the task.
+ * @param indent The indentation level in text output.
+ * @param date The occurrence date shown in front of the task, if any.
+ * @param list The list the task belongs to, shown when several lists are printed.
+ */
+void printTask(const Task& task, size_t number, unsigned indent = 0, const string& date = "", const string& list = "") {
+    if (outputFormat == OutputFormat::Text) {
+        string line = string(2 * indent, ' ') + (list.empty() ? "" : list + ": ") + (date.empty() ? "" : date + "  ") + formatTask(task, number);
+        line += '\n';
+        output.write(line);
+        return;
+    }
+    JsonRecord record;
+    if (!list.empty()) record.field("list", list);
+    record.field("number", static_cast<long long>(number))
+        .field("id", static_cast<long long>(task.id))
+        .field("description", task.description)
+        .field("completed", task.completed)
+        .field("tags", taskTags(task));
+    if (!date.empty()) record.field("date", date);
+    if (task.priority > 0) record.field("priority", static_cast<long long>(task.priority));
+    if (!task.due.empty()) record.field("due", task.due);
+    if (!task.every.empty()) record.field("every", task.every).field("since", task.since);
+    if (!task.created.empty()) record.field("created", task.created);
+    if (task.parent > 0) record.field("parent", static_cast<long long>(task.parent));
+    if (!task.after.empty()) record.field("after", task.after).field("blocked", static_cast<long long>(task.blockers));
+    if (!task.blocks.empty()) record.field("blocks", task.blocks);
+    if (task.spent > 0) record.field("spent", task.spent);
+    if (task.started != 0) record.field("started", static_cast<long long>(task.started));
+}
+
+/**
+ * @brief Maps task IDs to their 0-based positions in the list.
+ * @param tasks The vector of tasks.
+ * @return The position of every task, keyed by ID.
+ */
+unordered_map<unsigned, size_t> positionsById(const vector<Task>& tasks) {
+    unordered_map<unsigned, size_t> positions;
+    for (size_t i = 0; i < tasks.size(); ++i) {
+        positions[tasks[i].id] = i;
+    }
+    return positions;
+}
+
+/**
+ * @brief Finds a task by its ID.
+ * @param tasks The vector of tasks.
+ * @param positions The positions of the tasks by ID, see positionsById().
+ * @param id The ID to look up.
+ * @return The task, or nullptr if no task has the ID, e.g. for a dangling dependency.
+ */
+Task* taskById(vector<Task>& tasks, const unordered_map<unsigned, size_t>& positions, unsigned id) {
+    auto it = positions.find(id);
+    return it == positions.end() ? nullptr : &tasks[it->second];
+}
+
+/**
+ * @brief Returns the end of the subtree rooted at a task.
+ *
+ * Because of the preorder layout the subtree of the task at position i is the
+ * range [i, end), where end is the first later position that is not deeper.
+ * @param tasks The vector of tasks.
+ * @param i The 0-based position of the subtree root.
+ * @return The position one past the last task of the subtree.
+ */
+size_t subtreeEnd(const vector<Task>& tasks, size_t i) {
+    size_t end = i + 1;
+    while (end < tasks.size() && tasks[end].depth > tasks[i].depth) {
+        ++end;
+    }
+    return end;
+}
+
+/**
+ * @brief Lists all tasks.
+ *
+ * Iterates through the tasks vector and displays each task's description
+ * and its completion status. Subtasks are indented under their parent.
+ * @param tasks The vector of tasks to be listed.
+ * @param index If not 0, only the subtree of the task at this index is listed.
+ */
+void listTasks(vector<Task>& tasks, int index = 0) {
+    if (tasks.empty()) {
+        cout << "No tasks available." << endl;
+        return;
+    }
+    if (index < 0 || index > static_cast<int>(tasks.size())) {
+        cout << "Invalid task index." << endl;
+        return;
+    }
+
+    size_t first = index > 0 ? index - 1 : 0;
+    size_t last = index > 0 ? subtreeEnd(tasks, first) : tasks.size();
+    for (size_t i = first; i < last; ++i) {
+        printTask(tasks[i], i + 1, tasks[i].depth - tasks[first].depth);
+    }
+}
+
+/**
+ * @brief Parses the text of a new task.
+ *
+ * `pri:N`, `due:YYYY-MM-DD` and `every:INTERVAL` words set the matching fields;
+ * the remaining words are appended to the description.
+ * @param text The task text.
+ * @param entry The task that receives the parsed fields.
+ */
+void parseTaskText(const string& text, Task& entry) {
+    stringstream ss(text);
+    string word;
+    long count;
+    char unit;
+    while (ss >> word) {
+        if (word.size() == 5 && word.compare(0, 4, "pri:") == 0 && word[4] >= '1' && word[4] <= '9') {
+            entry.priority = word[4] - '0';
+        } else if (word.compare(0, 4, "due:") == 0 && isDate(word.substr(4))) {
+            entry.due = word.substr(4);
+        } else if (word.compare(0, 6, "every:") == 0 && parseInterval(word.substr(6), count, unit)) {
+            entry.every = word.substr(6);
+        } else {
+            if (!entry.description.empty()) entry.description += " ";
+            entry.description += word;
+        }
+    }
+}
+
+std::string IDS_FILENAME = getExecutableDirectory() + "\\todo.ids"; /**< File path of the highest task ID handed out */
+
+unsigned lastTaskId = 0;         /**< The highest task ID handed out for the list, including removed tasks. */
+bool lastTaskIdLoaded = false;   /**< Whether the ID file has been read. */
+bool lastTaskIdChanged = false;  /**< Whether an ID was handed out since the ID file was written. */
+
+/**
+ * @brief Hands out a task ID that was never used in the list.
+ *
+ * IDs are not reused after a task is removed, since the event journal and
+ * merges identify tasks by ID. The highest ID handed out is kept in the ID
+ * file, which is read on first use; the IDs in the list cover a missing or
+ * outdated file.
+ * @param highest The highest ID in the list.
+ * @return The new ID.
+ */
+unsigned newTaskId(unsigned highest) {
+    if (!lastTaskIdLoaded) {
+        ifstream file(IDS_FILENAME);
+        unsigned saved = 0;
+        if (file >> saved) lastTaskId = max(lastTaskId, saved);
+        lastTaskIdLoaded = true;
+    }
+    lastTaskId = max(lastTaskId, highest) + 1;
+    lastTaskIdChanged = true;
+    return lastTaskId;
+}
+
+/**
+ * @brief Writes the highest task ID handed out to the ID file, if it changed.
+ */
+void saveLastTaskId() {
+    if (!lastTaskIdChanged) return;
+    ofstream file(IDS_FILENAME);
+    file << lastTaskId << "\n";
+    lastTaskIdChanged = false;
+}
+
+/**
+ * @brief Adds a new task.
+ *
+ * Creates a new task with the given description and adds it to the tasks list.
+ * The words `pri:N`, `due:YYYY-MM-DD` and `every:INTERVAL` are taken out of the
+ * description and set the priority, due date and recurrence of the task instead.
+ * A recurring task without a due date is first due today.
+ * @param tasks The vector of tasks.
+ * @param task The description of the task to be added.
+ * @param parentIndex If not 0, the task is added as the last subtask of the task at this index.
+ */
+void addTask(vector<Task>& tasks, const string& task, int parentIndex = 0) {
+    if (parentIndex < 0 || parentIndex > static_cast<int>(tasks.size())) {
+        cout << "Invalid task index." << endl;
+        return;
+    }
+    Task entry("");
+    parseTaskText(task, entry);
+    entry.created = today();
+    if (!entry.every.empty()) {
+        if (entry.due.empty()) entry.due = entry.created;
+        entry.since = entry.due;
+    }
+    unsigned highest = 0;
+    for (const Task& existing : tasks) {
+        highest = max(highest, existing.id);
+    }
+    entry.id = newTaskId(highest);
+    size_t position = tasks.size();
+    if (parentIndex > 0) {
+        const Task& parent = tasks[parentIndex - 1];
+        entry.parent = parent.id;
+        entry.depth = parent.depth + 1;
+        position = subtreeEnd(tasks, parentIndex - 1);
+    }
+    tasks.insert(tasks.begin() + position, entry);
+    recordChange(Change::Added, entry);
+}
+
+/**
+ * @brief Removes a task by index.
+ *
+ * Removes the task at the specified index in the tasks list, together with
+ * all of its subtasks.
+ * @param tasks The vector of tasks.
+ * @param index The index of the task to be removed.
+ */
+void removeTask(vector<Task>& tasks, int index) {
+    if (index >= 1 && index <= tasks.size()) {
+        size_t end = subtreeEnd(tasks, index - 1);
+        unordered_map<unsigned, size_t> positions;
+        for (size_t i = index - 1; i < end; ++i) {
+            const Task& removed = tasks[i];
+            if (positions.empty() && (!removed.after.empty() || !removed.blocks.empty())) {
+                positions = positionsById(tasks);
+            }
+            // Drop the dependency edges on the other side; an unfinished task no longer blocks its dependents.
+            for (unsigned id : removed.after) {
+                Task* prerequisite = taskById(tasks, positions, id);
+                if (!prerequisite) continue;
+                vector<unsigned>& blocks = prerequisite->blocks;
+                blocks.erase(remove(blocks.begin(), blocks.end(), removed.id), blocks.end());
+            }
+            for (unsigned id : removed.blocks) {
+                Task* dependent = taskById(tasks, positions, id);
+                if (!dependent) continue;
+                dependent->after.erase(remove(dependent->after.begin(), dependent->after.end(), removed.id), dependent->after.end());
+                if (!removed.completed && dependent->blockers > 0) --dependent->blockers;
+            }
+            recordChange(Change::Removed, removed);
+        }
+        tasks.erase(tasks.begin() + index - 1, tasks.begin() + end);
+    } else {
+        cout << "Invalid task index." << endl;
+    }
+}
+
+/**
+ * @brief Completes the current occurrence of a recurring task.
+ *
+ * The occurrence is materialized as a completed one-off copy, and the
+ * recurring task's due date advances to the next occurrence. The copy is
+ * appended to the list, or for a subtask, to the subtasks of the same parent.
+ * @param tasks The vector of tasks.
+ * @param i The 0-based position of the recurring task.
+ * @return The 0-based position of the copy, or string::npos if there is no next occurrence.
+ */
+size_t completeOccurrence(vector<Task>& tasks, size_t i) {
+    string next = dateFromDays(dayNumber(tasks[i].due) + 1);
+    vector<string> upcoming = occurrencesBetween(tasks[i].since, tasks[i].every, next, "9999-12-31", 1);
+    if (upcoming.empty()) return string::npos;
+    Task instance(tasks[i].description, true);
+    instance.priority = tasks[i].priority;
+    instance.due = tasks[i].due;
+    instance.created = today();
+    instance.parent = tasks[i].parent;
+    instance.depth = tasks[i].depth;
+    unsigned highest = 0;
+    for (const Task& existing : tasks) {
+        highest = max(highest, existing.id);
+    }
+    instance.id = newTaskId(highest);
+    tasks[i].due = upcoming[0];
+    size_t position = tasks.size();
+    if (instance.parent != 0) {
+        size_t parent = i;
+        while (parent > 0 && tasks[parent].id != instance.parent) --parent;  // subtasks follow their parent
+        position = subtreeEnd(tasks, parent);
+    }
+    tasks.insert(tasks.begin() + position, instance);
+    recordChange(Change::Added, instance);
+    recordChange(Change::Rescheduled, tasks[i]);
+    return position;
+}
+
+/**
+ * @brief Lists the tasks due within a date window.
+ *
+ * Recurring tasks contribute one line per occurrence in the window; the
+ * occurrences are computed from the recurrence rule, not stored.
+ * @param tasks The vector of tasks.
+ * @param from The first date of the window as YYYY-MM-DD.
+ * @param to The last date of the window as YYYY-MM-DD.
+ */
+void listAgenda(const vector<Task>& tasks, const string& from, const string& to) {
+    vector<pair<string, size_t>> entries;
+    for (size_t i = 0; i < tasks.size(); ++i) {
+        const Task& task = tasks[i];
+        if (task.completed || task.due.empty()) continue;
+        if (task.every.empty()) {
+            if (task.due >= from && task.due <= to) entries.push_back({task.due, i});
+            continue;
+        }
+        // Occurrences before the current due date have already been completed.
+        for (const string& date : occurrencesBetween(task.since, task.every, max(from, task.due), to)) {
+            entries.push_back({date, i});
+        }
+    }
+    stable_sort(entries.begin(), entries.end(),
+                [](const pair<string, size_t>& a, const pair<string, size_t>& b) { return a.first < b.first; });
+    if (entries.empty()) {
+        cout << "Nothing due between " << from << " and " << to << "." << endl;
+    }
+    for (const auto& entry : entries) {
+        printTask(tasks[entry.second], entry.second + 1, 0, entry.first);
+    }
+}
+
+/**
+ * @brief Marks a task as completed.
+ *
+ * Sets the completion status of the task at the specified index, and of all
+ * of its subtasks, to true. Each completed task releases the tasks it blocks
+ * by decrementing their count of unfinished prerequisites.
+ *
+ * A recurring task stays open: the occurrence that was due is stored as a
+ * separate completed task at the end of the list, and the recurring task
+ * moves on to its next due date.
+ * @param tasks The vector of tasks.
+ * @param index The index of the task to be marked as done.
+ */
+void markDone(vector<Task>& tasks, int index) {
+    if (index >= 1 && index <= tasks.size()) {
+        size_t end = subtreeEnd(tasks, index - 1);
+        unordered_map<unsigned, size_t> positions;
+        for (size_t i = index - 1; i < end; ++i) {
+            if (!tasks[i].every.empty()) {
+                size_t copy = completeOccurrence(tasks, i);
+                if (copy == string::npos) continue;
+                if (copy < end) ++end;  // inserted into this subtree, already completed
+                positions.clear();      // positions after the copy have moved
+            } else if (!tasks[i].completed) {
+                tasks[i].completed = true;
+                if (positions.empty() && !tasks[i].blocks.empty()) {
+                    positions = positionsById(tasks);
+                }
+                for (unsigned id : tasks[i].blocks) {
+                    Task* dependent = taskById(tasks, positions, id);
+                    if (dependent && dependent->blockers > 0) --dependent->blockers;
+                }
+                recordChange(Change::Completed, tasks[i]);
+            }
+        }
+    } else {
+        cout << "Invalid task index." << endl;
+    }
+}
+
+/**
+ * @brief Makes one task blocked by another.
+ *
+ * The link is rejected if the prerequisite already depends, directly or
+ * through other tasks, on the blocked task, since that would create a cycle.
+ * @param tasks The vector of tasks.
+ * @param index The index of the task to be blocked.
+ * @param prerequisiteIndex The index of the task it waits for.
+ * @return false if an index is invalid or the link would create a cycle.
+ */
+bool addDependency(vector<Task>& tasks, int index, int prerequisiteIndex) {
+    if (index < 1 || index > static_cast<int>(tasks.size()) || prerequisiteIndex < 1 ||
+        prerequisiteIndex > static_cast<int>(tasks.size())) {
+        cout << "Invalid task index." << endl;
+        return false;
+    }
+    Task& task = tasks[index - 1];
+    Task& prerequisite = tasks[prerequisiteIndex - 1];
+    if (find(task.after.begin(), task.after.end(), prerequisite.id) != task.after.end()) {
+        return true;
+    }
+
+    unordered_map<unsigned, size_t> positions = positionsById(tasks);
+    vector<unsigned> pending = {prerequisite.id};
+    unordered_map<unsigned, bool> seen;
+    while (!pending.empty()) {
+        unsigned id = pending.back();
+        pending.pop_back();
+        if (id == task.id) {
+            cout << "Cannot block task " << index << " by task " << prerequisiteIndex
+                 << ": it would create a dependency cycle." << endl;
+            return false;
+        }
+        if (seen[id]) continue;
+        seen[id] = true;
+        const Task* current = taskById(tasks, positions, id);
+        if (current) pending.insert(pending.end(), current->after.begin(), current->after.end());
+    }
+
+    task.after.push_back(prerequisite.id);
+    prerequisite.blocks.push_back(task.id);
+    if (!prerequisite.completed) ++task.blockers;
+    return true;
+}
+
+/**
+ * @brief Removes the link that makes one task blocked by another.
+ * @param tasks The vector of tasks.
+ * @param index The index of the blocked task.
+ * @param prerequisiteIndex The index of the task it waits for.
+ * @return false if an index is invalid or the tasks are not linked.
+ */
+bool removeDependency(vector<Task>& tasks, int index, int prerequisiteIndex) {
+    if (index < 1 || index > static_cast<int>(tasks.size()) || prerequisiteIndex < 1 ||
+        prerequisiteIndex > static_cast<int>(tasks.size())) {
+        cout << "Invalid task index." << endl;
+        return false;
+    }
+    Task& task = tasks[index - 1];
+    Task& prerequisite = tasks[prerequisiteIndex - 1];
+    auto link = find(task.after.begin(), task.after.end(), prerequisite.id);
+    if (link == task.after.end()) {
+        cout << "Task " << index << " is not blocked by task " << prerequisiteIndex << "." << endl;
+        return false;
+    }
+    task.after.erase(link);
+    prerequisite.blocks.erase(remove(prerequisite.blocks.begin(), prerequisite.blocks.end(), task.id),
+                              prerequisite.blocks.end());
+    if (!prerequisite.completed && task.blockers > 0) --task.blockers;
+    return true;
+}
+
+/**
+ * @brief Lists the open tasks that are not blocked by any unfinished task.
+ * @param tasks The vector of tasks.
+ */
+void listReady(const vector<Task>& tasks) {
+    bool any = false;
+    for (size_t i = 0; i < tasks.size(); ++i) {
+        if (!tasks[i].completed && tasks[i].blockers == 0) {
+            printTask(tasks[i], i + 1);
+            any = true;
+        }
+    }
+    if (!any) {
+        cout << "No tasks are ready." << endl;
+    }
+}
+
+/**
+ * @brief Clears all tasks.
+ *
+ * Removes all tasks from the tasks list.
+ * @param tasks The vector of tasks.
+ */
+void resetTasks(vector<Task>& tasks) {
+    recordReset();
+    tasks.clear();
+}
+
+/**
+ * @brief Trims leading and trailing whitespaces from a string.
+ *
+ * This function removes any leading and trailing whitespace characters, including
+ * spaces, tabs, newlines, and carriage returns, from the input string.
+ *
+ * @param str The input string to be trimmed.
+ * @return A new string with leading and trailing whitespaces removed. If the input string
+ *         contains only whitespaces, an empty string is returned.
+ */
+string trim(const string& str) {
+    size_t first = str.find_first_not_of(" \t\n\r");
+    size_t last = str.find_last_not_of(" \t\n\r");
+    if (first == string::npos || last == string::npos) {
+        return "";
+    }
+    return str.substr(first, (last - first + 1));
+}
+
+/**
+ * @brief Recounts the unfinished prerequisites of every task.
+ *
+ * The saved `blocked` count is derived from `after`, so it is recounted on
+ * load; a hand edit or a merge may have left it wrong, or left dependencies on
+ * tasks that do not exist, which are not counted.
+ * @param tasks The vector of tasks.
+ */
+void countBlockers(vector<Task>& tasks) {
+    bool linked = any_of(tasks.begin(), tasks.end(), [](const Task& task) { return !task.after.empty() || task.blockers > 0; });
+    if (!linked) return;
+    unordered_map<unsigned, size_t> positions = positionsById(tasks);
+    for (Task& task : tasks) {
+        task.blockers = 0;
+        for (unsigned id : task.after) {
+            const Task* prerequisite = taskById(tasks, positions, id);
+            if (prerequisite && !prerequisite->completed) ++task.blockers;
+        }
+    }
+}
+
+/**
+ * @brief Computes subtask depths and restores the preorder layout if needed.
+ *
+ * Walks the list with a stack of open ancestors; if every task's parent is on
+ * the stack the layout is valid and only depths are set. Otherwise the list is
+ * rebuilt in preorder, keeping siblings in their current order. Tasks whose
+ * parent no longer exists become top-level tasks.
+ * @param tasks The vector of tasks.
+ */
+void layoutSubtasks(vector<Task>& tasks) {
+    vector<unsigned> ancestors;
+    bool valid = true;
+    for (Task& task : tasks) {
+        while (!ancestors.empty() && ancestors.back() != task.parent) {
+            ancestors.pop_back();
+        }
+        if (task.parent != 0 && ancestors.empty()) {
+            valid = false;
+            break;
+        }
+        task.depth = static_cast<unsigned>(ancestors.size());
+        ancestors.push_back(task.id);
+    }
+    if (valid) return;
+
+    unordered_map<unsigned, vector<size_t>> children;
+    unordered_map<unsigned, size_t> positions;
+    for (size_t i = 0; i < tasks.size(); ++i) positions[tasks[i].id] = i;
+    vector<size_t> roots;
+    for (size_t i = 0; i < tasks.size(); ++i) {
+        Task& task = tasks[i];
+        if (task.parent != 0 && (task.parent == task.id || !positions.count(task.parent))) task.parent = 0;
+        (task.parent == 0 ? roots : children[task.parent]).push_back(i);
+    }
+    vector<Task> ordered;
+    vector<bool> placed(tasks.size(), false);
+    vector<pair<size_t, unsigned>> stack;
+    auto visit = [&](size_t root) {
+        stack.push_back({root, 0});
+        while (!stack.empty()) {
+            auto [i, depth] = stack.back();
+            stack.pop_back();
+            if (placed[i]) continue;
+            placed[i] = true;
+            tasks[i].depth = depth;
+            ordered.push_back(tasks[i]);
+            const vector<size_t>& kids = children[tasks[i].id];
+            for (auto it = kids.rbegin(); it != kids.rend(); ++it) stack.push_back({*it, depth + 1});
+        }
+    };
+    for (size_t root : roots) visit(root);
+    for (size_t i = 0; i < tasks.size(); ++i) {
+        if (!placed[i]) {  // part of a parent cycle
+            tasks[i].parent = 0;
+            visit(i);
+        }
+    }
+    tasks = move(ordered);
+}
+
+/**
+ * @brief Parses one line of the task file.
+ *
+ * The line holds the completion status and the description, optionally followed
+ * by tab-separated `key=value` attributes. Unknown attributes are ignored.
+ * @param line The line to parse.
+ * @return The task; its ID is 0 if the line has none.
+ */
+Task parseTaskLine(const string& line) {
+    size_t tab = line.find('\t');
+    stringstream ss(line.substr(0, tab));
+    bool completed;
+    string desc;
+    ss >> completed;
+    getline(ss, desc);
+    desc = trim(desc);  // Trim leading/trailing spaces from description
+    Task task(desc, completed);
+    while (tab != string::npos) {
+        size_t next = line.find('\t', tab + 1);
+        string attribute = trim(line.substr(tab + 1, next == string::npos ? string::npos : next - tab - 1));
+        size_t eq = attribute.find('=');
+        string key = attribute.substr(0, eq);
+        string value = eq == string::npos ? "" : attribute.substr(eq + 1);
+        if (key == "id") {
+            task.id = static_cast<unsigned>(atoi(value.c_str()));
+        } else if (key == "parent") {
+            task.parent = static_cast<unsigned>(atoi(value.c_str()));
+        } else if (key == "after" || key == "blocks") {
+            vector<unsigned>& ids = key == "after" ? task.after : task.blocks;
+            stringstream list(value);
+            string id;
+            while (getline(list, id, ',')) {
+                ids.push_back(static_cast<unsigned>(atoi(id.c_str())));
+            }
+        } else if (key == "blocked") {
+            task.blockers = static_cast<unsigned>(atoi(value.c_str()));
+        } else if (key == "pri") {
+            task.priority = atoi(value.c_str());
+        } else if (key == "due") {
+            task.due = value;
+        } else if (key == "every") {
+            task.every = value;
+        } else if (key == "since") {
+            task.since = value;
+        } else if (key == "spent") {
+            task.spent = atoll(value.c_str());
+        } else if (key == "started") {
+            task.started = static_cast<time_t>(atoll(value.c_str()));
+        } else if (key == "created") {
+            task.created = value;
+        }
+        tab = next;
+    }
+    if (!task.every.empty()) {
+        if (task.due.empty()) task.due = task.since.empty() ? today() : task.since;
+        if (task.since.empty()) task.since = task.due;
+    }
+    return task;
+}
+
+/**
+ * @brief Loads tasks from a file into the task list.
+ *
+ * This function reads tasks from the file of the selected list (`FILENAME`).
+ * Each task in the file is expected to be stored on a new line in the format:
+ *
+ *     <completion_status> <task_description>
+ *
+ * where:
+ * - `<completion_status>` is a boolean (0 or 1) indicating whether the task is completed.
+ * - `<task_description>` is the string description of the task.
+ *
+ * The description may be followed by tab-separated `key=value` attributes
+ * (`id`, `parent`, `after`, `blocks`, `blocked`, `pri`, `due`, `every`, `since`, `spent`, `started`, `created`). Lines without
+ * attributes are read as before;
+ * tasks without an `id` get new IDs from newTaskId().
+ * If the file does not keep subtasks in preorder, the list is reordered, and
+ * the `blocked` counts are recounted with countBlockers().
+ *
+ * Tasks are loaded into the provided vector, clearing any existing tasks before loading.
+ * If the file cannot be opened, a message is displayed to the user.
+ *
+ * @param tasks The vector of tasks to be populated from the file.
+ */
+void loadTasksFromFile(vector<Task>& tasks) {
+    ifstream file(FILENAME);
+    if (file.is_open()) {
+        string line;
+        tasks.clear();
+        while (getline(file, line)) {
+            tasks.push_back(parseTaskLine(line));
+        }
+        file.close();
+        unsigned highest = 0;
+        for (const Task& task : tasks) {
+            highest = max(highest, task.id);
+        }
+        for (Task& task : tasks) {
+            if (task.id == 0) task.id = newTaskId(highest);
+        }
+        layoutSubtasks(tasks);
+        countBlockers(tasks);
+    } else {
+        cout << "No saved tasks found." << endl;
+    }
+}
+
+/**
+ * @brief Writes one task as a line of the task file.
+ * @param out The stream to write to.
+ * @param task The task to write.
+ */
+void writeTaskLine(ostream& out, const Task& task) {
+    out << task.completed << " " << task.description << "\tid=" << task.id;
+    if (task.parent > 0) out << "\tparent=" << task.parent;
+    for (const auto* ids : {&task.after, &task.blocks}) {
+        for (size_t i = 0; i < ids->size(); ++i) {
+            out << (i == 0 ? (ids == &task.after ? "\tafter=" : "\tblocks=") : ",") << (*ids)[i];
+        }
+    }
+    if (task.blockers > 0) out << "\tblocked=" << task.blockers;
+    if (task.priority > 0) out << "\tpri=" << task.priority;
+    if (!task.due.empty()) out << "\tdue=" << task.due;
+    if (!task.every.empty()) out << "\tevery=" << task.every << "\tsince=" << task.since;
+    if (task.spent > 0) out << "\tspent=" << task.spent;
+    if (task.started != 0) out << "\tstarted=" << static_cast<long long>(task.started);
+    if (!task.created.empty()) out << "\tcreated=" << task.created;
+    out << '\n';
+}
+
+function<void()> deferSave; /**< Set while `todo shell` runs; saveTasks() then leaves the writing to its writer thread. */
+
+/**
+ * @brief Writes the task file and the files kept alongside it.
+ *
+ * Used by saveTasks(), and by the writer thread of `todo shell`.
+ * @param tasks The vector of tasks to be saved.
+ */
+void writeTasks(const vector<Task>& tasks) {
+    prepareSidecars();
+    ofstream file(FILENAME);
+    if (file.is_open()) {
+        for (const auto& task : tasks) {
+            writeTaskLine(file, task);
+        }
+        file.close();
+    }
+    if (!file) {
+        cout << "Cannot write '" << FILENAME << "'." << endl;
+        return;  // the files kept alongside it must not get ahead of it
+    }
+    saveSidecars(tasks);
+}
+
+/**
+ * @brief Writes the task file atomically and durably, then the files kept alongside it.
+ *
+ * The tasks are written to a temporary file, which is flushed to disk and then
+ * moved over the task file, so a failure leaves either the old or the new
+ * list, never a partial one. The move is the commit point: the event journal
+ * is appended after it, and flushed to disk before this returns, so a crash in
+ * between leaves the new list without its journal group. Used by `todo batch`.
+ * @param tasks The vector of tasks to be saved.
+ * @return false if the task file could not be replaced.
+ */
+bool commitTasks(const vector<Task>& tasks) {
+    prepareSidecars();
+    string temp = FILENAME + ".tmp";
+    ofstream file(temp);
+    for (const auto& task : tasks) {
+        writeTaskLine(file, task);
+    }
+    file.close();
+    bool written = file && flushToDisk(temp);
+    if (!written || !MoveFileExA(temp.c_str(), FILENAME.c_str(), MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH)) {
+        cout << "Cannot write '" << FILENAME << "'." << endl;
+        error_code ec;
+        filesystem::remove(temp, ec);
+        return false;
+    }
+    saveSidecars(tasks, true);
+    return true;
+}
+
+/**
+ * @brief Saves tasks to the file.
+ *
+ * Writes the current tasks to the "todo.txt" file, saving the description and completion status.
+ * Attributes that are set are appended as tab-separated `key=value` pairs.
+ * The files kept alongside it (views, result cache, statistics) are updated as well.
+ * In `todo shell` the writing is left to the shell's writer thread.
+ * @param tasks The vector of tasks to be saved.
+ */
+void saveTasks(const vector<Task>& tasks) {
+    if (deferSave) {
+        deferSave();
+        return;
+    }
+    writeTasks(tasks);
+}
+
+/**
+ * @brief A fixed-size set of task positions stored as 64-bit words.
+ */
+struct Bitmap {
+    vector<uint64_t> words; /**< The bits, 64 positions per word. */
+
+    /**
+     * @brief Resizes the bitmap to hold n positions, all cleared.
+     * @param n The number of positions.
+     */
+    void reset(size_t n) {
+        words.assign((n + 63) / 64, 0);
+    }
+
+    /**
+     * @brief Sets the bit for a position, growing the bitmap if needed.
+     * @param i The position to set.
+     */
+    void set(size_t i) {
+        if (i / 64 >= words.size()) words.resize(i / 64 + 1, 0);
+        words[i / 64] |= uint64_t(1) << (i % 64);
+    }
+
+    /**
+     * @brief Tests the bit for a position.
+     * @param i The position to test.
+     * @return true if the position is in the set.
+     */
+    bool test(size_t i) const {
+        return i / 64 < words.size() && (words[i / 64] >> (i % 64)) & 1;
+    }
+
+    /**
+     * @brief Counts the positions in the set.
+     * @return The number of set bits.
+     */
+    size_t count() const {
+        size_t total = 0;
+        for (uint64_t word : words) {
+            while (word) {
+                word &= word - 1;
+                ++total;
+            }
+        }
+        return total;
+    }
+};
+
+/**
+ * @struct TaskIndex
+ * @brief In-memory indexes over the task list used by the query planner.
+ *
+ * The indexes are built in one pass after loading and refer to tasks by their
+ * 0-based position in the tasks vector.
+ */
+struct TaskIndex {
+    size_t size = 0;                                 /**< The number of indexed tasks. */
+    Bitmap done;                                     /**< Status bitmap, set for completed tasks. */
+    map<string, Bitmap> tags;                        /**< One bitmap per tag. */
+    unordered_map<string, vector<size_t>> words;     /**< Inverted index from lower-case word to positions. */
+    vector<pair<string, size_t>> due;                /**< (due date, position) pairs sorted by date. */
+};
+
+/**
+ * @brief Builds the query indexes for a task list.
+ * @param tasks The tasks to index.
+ * @return The populated index.
+ */
+TaskIndex buildIndex(const vector<Task>& tasks) {
+    TaskIndex index;
+    index.size = tasks.size();
+    index.done.reset(tasks.size());
+    for (size_t i = 0; i < tasks.size(); ++i) {
+        const Task& task = tasks[i];
+        if (task.completed) index.done.set(i);
+        for (const string& tag : taskTags(task)) {
+            index.tags[tag].set(i);
+        }
+        vector<string> words = tokenize(task.description);
+        sort(words.begin(), words.end());
+        words.erase(unique(words.begin(), words.end()), words.end());
+        for (const string& word : words) {
+            index.words[word].push_back(i);
+        }
+        if (!task.due.empty()) index.due.push_back({task.due, i});
+    }
+    sort(index.due.begin(), index.due.end());
+    return index;
+}
+
+/**
+ * @brief The task fields a query can filter and sort on.
+ */
+enum class Field { Status, Tag, Text, Due, Created, Priority };
+
+/**
+ * @brief The comparison operators of the query language.
+ *
+ * `Like` is the `~` operator, a case-insensitive substring match on the description.
+ */
+enum class Op { Eq, Ne, Lt, Le, Gt, Ge, Like };
+
+/**
+ * @struct QueryNode
+ * @brief A node of a parsed query expression: a predicate or a boolean combination.
+ */
+struct QueryNode {
+    enum Kind { And, Or, Not, Pred } kind;   /**< The node type. */
+    Field field = Field::Text;              /**< The field compared by a predicate. */
+    Op op = Op::Eq;                          /**< The operator of a predicate. */
+    string value;                            /**< The normalized operand of a predicate. */
+    unique_ptr<QueryNode> left;              /**< The first operand of And/Or/Not. */
+    unique_ptr<QueryNode> right;             /**< The second operand of And/Or. */
+
+    /**
+     * @brief Constructs a node of the given kind.
+     * @param k The node type.
+     */
+    explicit QueryNode(Kind k) : kind(k) {}
+};
+
+/**
+ * @struct Query
+ * @brief A parsed query: a filter expression, an optional ordering and a limit.
+ */
+struct Query {
+    unique_ptr<QueryNode> where;      /**< The filter, or null to match every task. */
+    bool ordered = false;             /**< Whether an `order by` clause was given. */
+    Field orderBy = Field::Priority;  /**< The sort field. */
+    bool descending = false;          /**< Whether the sort is descending. */
+    size_t limit = string::npos;      /**< The maximum number of results. */
+};
+
+/**
+ * @brief Splits a query string into words, quoted strings, operators and parentheses.
+ * @param text The query text.
+ * @param tokens Receives the tokens; quoted strings keep their leading quote.
+ * @param error Receives a message if the text cannot be split.
+ * @return true on success.
+ */
+bool lexQuery(const string& text, vector<string>& tokens, string& error) {
+    size_t i = 0;
+    while (i < text.size()) {
+        char c = text[i];
+        if (isspace(static_cast<unsigned char>(c))) {
+            ++i;
+        } else if (c == '(' || c == ')' || c == ':' || c == '~') {
+            tokens.push_back(string(1, c));
+            ++i;
+        } else if (c == '<' || c == '>' || c == '=' || c == '!') {
+            bool twoChars = i + 1 < text.size() && text[i + 1] == '=';
+            if (c == '!' && !twoChars) {
+                error = "expected '=' after '!'";
+                return false;
+            }
+            tokens.push_back(text.substr(i, twoChars ? 2 : 1));
+            i += twoChars ? 2 : 1;
+        } else if (c == '"' || c == '\'') {
+            size_t end = text.find(c, i + 1);
+            if (end == string::npos) {
+                error = "unterminated string";
+                return false;
+            }
+            tokens.push_back("\"" + text.substr(i + 1, end - i - 1));
+            i = end + 1;
+        } else {
+            size_t start = i;
+            while (i < text.size() && !isspace(static_cast<unsigned char>(text[i])) &&
+                   string("():~<>=!\"'").find(text[i]) == string::npos) {
+                ++i;
+            }
+            tokens.push_back(text.substr(start, i - start));
+        }
+    }
+    return true;
+}
+
+/**
+ * @brief Recursive-descent parser for the query language.
+ *
+ * Grammar (keywords are case-insensitive):
+ *
+ *     query     := [expr] ["order" "by" field ["asc"|"desc"]] ["limit" N]
+ *     expr      := term ("or" term)*
+ *     term      := factor (["and"] factor)*
+ *     factor    := "not" factor | "(" expr ")" | predicate
+ *     predicate := field op value | +tag | word | "quoted text"
+ *
+ * Fields are `status`, `tag`, `text`, `due`, `created` and `priority` (`pri`);
+ * operators are `:`, `=`, `!=`, `<`, `<=`, `>`, `>=` and `~`.
+ */
+class QueryParser {
+public:
+    /**
+     * @brief Constructs a parser over lexed tokens.
+     * @param tokens The tokens produced by lexQuery().
+     */
+    explicit QueryParser(const vector<string>& tokens) : tokens(tokens), pos(0) {}
+
+    /**
+     * @brief Parses the whole token list.
+     * @param query Receives the parsed query.
+     * @param error Receives a message on failure.
+     * @return true on success.
+     */
+    bool parse(Query& query, string& error) {
+        if (!atClauseEnd()) {
+            query.where = parseOr();
+            if (!query.where) {
+                error = this->error;
+                return false;
+            }
+        }
+        if (keyword("order")) {
+            ++pos;
+            if (!keyword("by")) {
+                error = "expected 'by' after 'order'";
+                return false;
+            }
+            ++pos;
+            if (pos >= tokens.size() || !parseField(toLower(tokens[pos]), query.orderBy)) {
+                error = "expected a field after 'order by'";
+                return false;
+            }
+            ++pos;
+            query.ordered = true;
+            if (keyword("asc") || keyword("desc")) {
+                query.descending = keyword("desc");
+                ++pos;
+            }
+        }
+        if (keyword("limit")) {
+            ++pos;
+            if (pos >= tokens.size() || tokens[pos].empty() ||
+                tokens[pos].find_first_not_of("0123456789") != string::npos) {
+                error = "expected a number after 'limit'";
+                return false;
+            }
+            errno = 0;
+            unsigned long long limit = strtoull(tokens[pos++].c_str(), nullptr, 10);
+            if (errno == ERANGE || limit > numeric_limits<size_t>::max()) {
+                error = "limit is too large";
+                return false;
+            }
+            query.limit = static_cast<size_t>(limit);
+        }
+        if (pos < tokens.size()) {
+            error = "unexpected '" + tokens[pos] + "'";
+            return false;
+        }
+        return true;
+    }
+
+    /**
+     * @brief Maps a field name to a Field.
+     * @param name The lower-case field name.
+     * @param field Receives the field.
+     * @return true if the name is a known field.
+     */
+    static bool parseField(const string& name, Field& field) {
+        if (name == "status") field = Field::Status;
+        else if (name == "tag") field = Field::Tag;
+        else if (name == "text" || name == "description") field = Field::Text;
+        else if (name == "due") field = Field::Due;
+        else if (name == "created") field = Field::Created;
+        else if (name == "priority" || name == "pri") field = Field::Priority;
+        else return false;
+        return true;
+    }
+
+private:
+    const vector<string>& tokens;
+    size_t pos;
+    string error;
+
+    bool keyword(const char* word) const {
+        return pos < tokens.size() && toLower(tokens[pos]) == word;
+    }
+
+    bool atClauseEnd() const {
+        return pos >= tokens.size() || keyword("order") || keyword("limit");
+    }
+
+    unique_ptr<QueryNode> combine(QueryNode::Kind kind, unique_ptr<QueryNode> left, unique_ptr<QueryNode> right) {
+        auto node = make_unique<QueryNode>(kind);
+        node->left = move(left);
+        node->right = move(right);
+        return node;
+    }
+
+    unique_ptr<QueryNode> parseOr() {
+        auto left = parseAnd();
+        while (left && keyword("or")) {
+            ++pos;
+            auto right = parseAnd();
+            if (!right) return nullptr;
+            left = combine(QueryNode::Or, move(left), move(right));
+        }
+        return left;
+    }
+
+    unique_ptr<QueryNode> parseAnd() {
+        auto left = parseFactor();
+        while (left && !atClauseEnd() && !keyword("or") && tokens[pos] != ")") {
+            if (keyword("and")) ++pos;
+            auto right = parseFactor();
+            if (!right) return nullptr;
+            left = combine(QueryNode::And, move(left), move(right));
+        }
+        return left;
+    }
+
+    unique_ptr<QueryNode> parseFactor() {
+        if (pos >= tokens.size()) {
+            error = "unexpected end of query";
+            return nullptr;
+        }
+        if (keyword("not")) {
+            ++pos;
+            auto operand = parseFactor();
+            if (!operand) return nullptr;
+            return combine(QueryNode::Not, move(operand), nullptr);
+        }
+        if (tokens[pos] == "(") {
+            ++pos;
+            auto inner = parseOr();
+            if (!inner) return nullptr;
+            if (pos >= tokens.size() || tokens[pos] != ")") {
+                error = "missing ')'";
+                return nullptr;
+            }
+            ++pos;
+            return inner;
+        }
+        return parsePredicate();
+    }
+
+    unique_ptr<QueryNode> parsePredicate() {
+        auto node = make_unique<QueryNode>(QueryNode::Pred);
+        const string& token = tokens[pos++];
+        if (token[0] == '"') {
+            node->field = Field::Text;
+            node->op = Op::Like;
+            node->value = toLower(token.substr(1));
+            return node;
+        }
+        if (token.size() > 1 && token[0] == '+') {
+            node->field = Field::Tag;
+            node->value = toLower(token.substr(1));
+            return node;
+        }
+        static const map<string, Op> ops = {
+            {":", Op::Eq}, {"=", Op::Eq}, {"!=", Op::Ne}, {"<", Op::Lt},
+            {"<=", Op::Le}, {">", Op::Gt}, {">=", Op::Ge}, {"~", Op::Like}};
+        auto op = pos < tokens.size() ? ops.find(tokens[pos]) : ops.end();
+        if (op == ops.end()) {
+            if (string("():~<>=!").find(token[0]) != string::npos) {
+                error = "unexpected '" + token + "'";
+                return nullptr;
+            }
+            vector<string> words = tokenize(token);
+            if (words.size() != 1) {
+                node->op = Op::Like;
+                node->value = toLower(token);
+            } else {
+                node->value = words[0];
+            }
+            return node;
+        }
+        if (!parseField(toLower(token), node->field)) {
+            error = "unknown field '" + token + "'";
+            return nullptr;
+        }
+        node->op = op->second;
+        if (++pos >= tokens.size()) {
+            error = "missing value after '" + token + op->first + "'";
+            return nullptr;
+        }
+        string value = tokens[pos++];
+        if (!value.empty() && value[0] == '"') value = value.substr(1);
+        if (!validate(*node, value)) return nullptr;
+        return node;
+    }
+
+    bool validate(QueryNode& node, const string& raw) {
+        string value = toLower(raw);
+        bool equality = node.op == Op::Eq || node.op == Op::Ne;
+        switch (node.field) {
+        case Field::Status:
+            if (!equality || (value != "open" && value != "done")) {
+                error = "status only supports ':' or '!=' with 'open' or 'done'";
+                return false;
+            }
+            break;
+        case Field::Tag:
+            if (!equality) {
+                error = "tag only supports ':' and '!='";
+                return false;
+            }
+            if (!value.empty() && value[0] == '+') value = value.substr(1);
+            break;
+        case Field::Text:
+            if (node.op != Op::Like && !equality) {
+                error = "text only supports ':', '!=' and '~'";
+                return false;
+            }
+            if (node.op != Op::Like) {
+                vector<string> words = tokenize(value);
+                if (words.size() != 1) {
+                    node.op = node.op == Op::Ne ? Op::Ne : Op::Like;
+                } else {
+                    value = words[0];
+                }
+            }
+            break;
+        case Field::Due:
+        case Field::Created:
+            if (value == "today") value = today();
+            if (node.op == Op::Like || !isDate(value)) {
+                error = "dates must be compared with YYYY-MM-DD or 'today'";
+                return false;
+            }
+            break;
+        case Field::Priority:
+            if (node.op == Op::Like || value.size() != 1 || value[0] < '1' || value[0] > '9') {
+                error = "priority must be compared with a number from 1 to 9";
+                return false;
+            }
+            break;
+        }
+        node.value = value;
+        return true;
+    }
+};
+
+/**
+ * @brief Parses a query string.
+ * @param text The query text.
+ * @param query Receives the parsed query.
+ * @param error Receives a message on failure.
+ * @return true on success.
+ */
+bool parseQuery(const string& text, Query& query, string& error) {
+    vector<string> tokens;
+    if (!lexQuery(text, tokens, error)) return false;
+    QueryParser parser(tokens);
+    return parser.parse(query, error);
+}
+
+/**
+ * @brief Applies a comparison operator to the result of a three-way comparison.
+ * @param cmp Negative, zero or positive, as returned by string::compare.
+ * @param op The operator.
+ * @return The outcome of the comparison.
+ */
+bool compareWith(int cmp, Op op) {
+    switch (op) {
+    case Op::Eq: return cmp == 0;
+    case Op::Ne: return cmp != 0;
+    case Op::Lt: return cmp < 0;
+    case Op::Le: return cmp <= 0;
+    case Op::Gt: return cmp > 0;
+    case Op::Ge: return cmp >= 0;
+    default: return false;
+    }
+}
+
+/**
+ * @brief Checks whether a description contains a word or tag in the text column.
+ * @param begin The start of the lower-cased description.
+ * @param end The end of the lower-cased description.
+ * @param needle The word, or the tag with its leading `+`.
+ * @param tag If true, the needle must be a whole whitespace-separated word;
+ *            otherwise it must be bounded by non-alphanumeric characters.
+ * @return true if the needle occurs with the required boundaries.
+ */
+bool containsWord(const char* begin, const char* end, const string& needle, bool tag) {
+    auto boundary = [tag](char c) {
+        return tag ? isspace(static_cast<unsigned char>(c)) != 0 : !isalnum(static_cast<unsigned char>(c));
+    };
+    for (const char* p = begin; (p = search(p, end, needle.begin(), needle.end())) != end; ++p) {
+        const char* after = p + needle.size();
+        if ((p == begin || boundary(p[-1])) && (after == end || boundary(*after))) return true;
+    }
+    return false;
+}
+
+/**
+ * @brief Evaluates a query expression against one task.
+ *
+ * Comparisons on an unset due date, creation date or priority never match.
+ * @param node The expression to evaluate.
+ * @param task The task to test.
+ * @return true if the task satisfies the expression.
+ */
+bool matchesQuery(const QueryNode& node, const Task& task) {
+    switch (node.kind) {
+    case QueryNode::And: return matchesQuery(*node.left, task) && matchesQuery(*node.right, task);
+    case QueryNode::Or: return matchesQuery(*node.left, task) || matchesQuery(*node.right, task);
+    case QueryNode::Not: return !matchesQuery(*node.left, task);
+    case QueryNode::Pred: break;
+    }
+    bool found = false;
+    switch (node.field) {
+    case Field::Status:
+        return compareWith(task.completed == (node.value == "done") ? 0 : 1, node.op);
+    case Field::Tag:
+        for (const string& tag : taskTags(task)) {
+            found = found || tag == node.value;
+        }
+        return found == (node.op == Op::Eq);
+    case Field::Text:
+        if (node.op == Op::Like) {
+            return toLower(task.description).find(node.value) != string::npos;
+        }
+        {
+            // The same word and phrase matching as the vectorized engine
+            string text = toLower(task.description);
+            found = containsWord(text.data(), text.data() + text.size(), node.value, false);
+        }
+        return found == (node.op == Op::Eq);
+    case Field::Due:
+        return !task.due.empty() && compareWith(task.due.compare(node.value), node.op);
+    case Field::Created:
+        return !task.created.empty() && compareWith(task.created.compare(node.value), node.op);
+    case Field::Priority:
+        return task.priority > 0 && compareWith(task.priority - (node.value[0] - '0'), node.op);
+    }
+    return false;
+}
+
+/**
+ * @brief Formats a query expression in canonical form.
+ * @param node The expression to format.
+ * @return The expression text with explicit `and`/`or` and parentheses.
+ */
+string formatQuery(const QueryNode& node) {
+    static const char* fieldNames[] = {"status", "tag", "text", "due", "created", "priority"};
+    static const char* opNames[] = {":", "!=", "<", "<=", ">", ">=", "~"};
+    switch (node.kind) {
+    case QueryNode::And: return "(" + formatQuery(*node.left) + " and " + formatQuery(*node.right) + ")";
+    case QueryNode::Or: return "(" + formatQuery(*node.left) + " or " + formatQuery(*node.right) + ")";
+    case QueryNode::Not: return "not " + formatQuery(*node.left);
+    case QueryNode::Pred: break;
+    }
+    string value = node.value.find_first_of(" \t\"") == string::npos ? node.value : "'" + node.value + "'";
+    return string(fieldNames[static_cast<int>(node.field)]) + opNames[static_cast<int>(node.op)] + value;
+}
+
+/**
+ * @struct QueryPlan
+ * @brief The access path chosen for a query and its estimated cost.
+ *
+ * Costs are measured in tasks touched: a full scan touches every task, an index
+ * access touches only the tasks it returns plus the work to find them.
+ */
+struct QueryPlan {
+    enum Access { FullScan, StatusBitmap, TagBitmap, WordIndex, DueIndex } access = FullScan; /**< The access path. */
+    const QueryNode* driver = nullptr; /**< The predicate answered by the index, if any. */
+    size_t estimatedRows = 0;          /**< The number of candidate tasks the access path yields. */
+    size_t estimatedCost = 0;          /**< The estimated cost of the access path. */
+    size_t scanCost = 0;               /**< The cost of a full scan, for comparison. */
+};
+
+/**
+ * @brief Collects the top-level conjuncts of an expression.
+ * @param node The expression.
+ * @param out Receives the predicates that must all hold.
+ */
+void collectConjuncts(const QueryNode* node, vector<const QueryNode*>& out) {
+    if (node->kind == QueryNode::And) {
+        collectConjuncts(node->left.get(), out);
+        collectConjuncts(node->right.get(), out);
+    } else {
+        out.push_back(node);
+    }
+}
+
+/**
+ * @brief Returns the range of the due-date index matching a date predicate.
+ * @param index The task index.
+ * @param node A due-date predicate with a range operator.
+ * @return The [first, last) range of matching entries in index.due.
+ */
+pair<size_t, size_t> dueRange(const TaskIndex& index, const QueryNode& node) {
+    auto lower = [&](const string& date) {
+        return lower_bound(index.due.begin(), index.due.end(), make_pair(date, size_t(0))) - index.due.begin();
+    };
+    auto upper = [&](const string& date) {
+        return lower_bound(index.due.begin(), index.due.end(), make_pair(date, string::npos)) - index.due.begin();
+    };
+    size_t first = 0, last = index.due.size();
+    switch (node.op) {
+    case Op::Eq: first = lower(node.value); last = upper(node.value); break;
+    case Op::Lt: last = lower(node.value); break;
+    case Op::Le: last = upper(node.value); break;
+    case Op::Gt: first = upper(node.value); break;
+    case Op::Ge: first = lower(node.value); break;
+    default: break;
+    }
+    return {first, max(first, last)};
+}
+
+/**
+ * @brief Chooses the cheapest access path for a query.
+ *
+ * Every top-level conjunct that an index can answer is costed; the cheapest one
+ * drives the query and the full filter is re-checked on its candidates. Queries
+ * without an indexable conjunct, or whose best index is no cheaper, use a scan.
+ * @param query The parsed query.
+ * @param index The task index.
+ * @return The chosen plan.
+ */
+QueryPlan planQuery(const Query& query, const TaskIndex& index) {
+    QueryPlan plan;
+    plan.scanCost = plan.estimatedCost = plan.estimatedRows = index.size;
+    if (!query.where) return plan;
+
+    vector<const QueryNode*> conjuncts;
+    collectConjuncts(query.where.get(), conjuncts);
+    size_t bitmapWords = (index.size + 63) / 64;
+    for (const QueryNode* node : conjuncts) {
+        if (node->kind != QueryNode::Pred) continue;
+        QueryPlan candidate;
+        if (node->field == Field::Status && node->op != Op::Ne) {
+            size_t done = index.done.count();
+            candidate.access = QueryPlan::StatusBitmap;
+            candidate.estimatedRows = node->value == "done" ? done : index.size - done;
+            candidate.estimatedCost = bitmapWords + candidate.estimatedRows;
+        } else if (node->field == Field::Tag && node->op == Op::Eq) {
+            auto it = index.tags.find(node->value);
+            candidate.access = QueryPlan::TagBitmap;
+            candidate.estimatedRows = it == index.tags.end() ? 0 : it->second.count();
+            candidate.estimatedCost = bitmapWords + candidate.estimatedRows;
+        } else if (node->field == Field::Text && node->op == Op::Eq) {
+            auto it = index.words.find(node->value);
+            candidate.access = QueryPlan::WordIndex;
+            candidate.estimatedRows = it == index.words.end() ? 0 : it->second.size();
+            candidate.estimatedCost = 1 + candidate.estimatedRows;
+        } else if (node->field == Field::Due && node->op != Op::Ne) {
+            pair<size_t, size_t> range = dueRange(index, *node);
+            candidate.access = QueryPlan::DueIndex;
+            candidate.estimatedRows = range.second - range.first;
+            candidate.estimatedCost = static_cast<size_t>(log2(index.due.size() + 1)) + 1 + candidate.estimatedRows;
+        } else {
+            continue;
+        }
+        if (candidate.estimatedCost < plan.estimatedCost) {
+            candidate.driver = node;
+            candidate.scanCost = plan.scanCost;
+            plan = candidate;
+        }
+    }
+    return plan;
+}
+
+/**
+ * @brief Returns the candidate rows produced by the access path of a plan.
+ * @param index The task index.
+ * @param plan The plan returned by planQuery().
+ * @return The 0-based positions of the candidate tasks in ascending order.
+ */
+vector<size_t> candidateRows(const TaskIndex& index, const QueryPlan& plan) {
+    vector<size_t> candidates;
+    switch (plan.access) {
+    case QueryPlan::FullScan:
+        for (size_t i = 0; i < index.size; ++i) candidates.push_back(i);
+        break;
+    case QueryPlan::StatusBitmap: {
+        bool wantDone = plan.driver->value == "done";
+        for (size_t w = 0; w < (index.size + 63) / 64; ++w) {
+            uint64_t bits = w < index.done.words.size() ? index.done.words[w] : 0;
+            if (!wantDone) bits = ~bits;
+            for (; bits; bits &= bits - 1) {
+                size_t i = w * 64 + __builtin_ctzll(bits);
+                if (i < index.size) candidates.push_back(i);
+            }
+        }
+        break;
+    }
+    case QueryPlan::TagBitmap: {
+        auto it = index.tags.find(plan.driver->value);
+        if (it == index.tags.end()) break;
+        for (size_t w = 0; w < it->second.words.size(); ++w) {
+            for (uint64_t bits = it->second.words[w]; bits; bits &= bits - 1) {
+                candidates.push_back(w * 64 + __builtin_ctzll(bits));
+            }
+        }
+        break;
+    }
+    case QueryPlan::WordIndex: {
+        auto it = index.words.find(plan.driver->value);
+        if (it != index.words.end()) candidates = it->second;
+        break;
+    }
+    case QueryPlan::DueIndex: {
+        pair<size_t, size_t> range = dueRange(index, *plan.driver);
+        for (size_t i = range.first; i < range.second; ++i) candidates.push_back(index.due[i].second);
+        sort(candidates.begin(), candidates.end());
+        break;
+    }
+    }
+
+    return candidates;
+}
+
+/**
+ * @brief The number of rows the vectorized engine evaluates per batch.
+ */
+const size_t BATCH_SIZE = 1024;
+
+/**
+ * @struct TaskColumns
+ * @brief Column-oriented copy of the task fields that queries filter on.
+ *
+ * Each field is stored contiguously so that predicates can be evaluated over
+ * batches of rows with tight loops instead of walking Task objects one by one.
+ * Dates are stored as YYYYMMDD integers and unset values as 0.
+ */
+struct TaskColumns {
+    size_t size = 0;               /**< The number of rows. */
+    vector<uint8_t> done;          /**< 1 for completed tasks, 0 otherwise. */
+    vector<uint8_t> priority;      /**< The priority, 0 if unset. */
+    vector<int32_t> due;           /**< The due date as YYYYMMDD, 0 if unset. */
+    vector<int32_t> created;       /**< The creation date as YYYYMMDD, 0 if unset. */
+    vector<uint32_t> textOffset;   /**< Row i's description is text[textOffset[i], textOffset[i + 1]). */
+    string text;                   /**< All descriptions, lower-cased and concatenated. */
+};
+
+/**
+ * @brief Converts a YYYY-MM-DD date to a YYYYMMDD integer.
+ * @param date The date string.
+ * @return The date as an integer, or 0 if the string is not a date.
+ */
+int32_t dateNumber(const string& date) {
+    if (!isDate(date)) return 0;
+    return atoi(date.substr(0, 4).c_str()) * 10000 + atoi(date.substr(5, 2).c_str()) * 100 + atoi(date.substr(8, 2).c_str());
+}
+
+/**
+ * @brief Builds the columnar representation of a task list.
+ * @param tasks The tasks to convert.
+ * @return The populated columns.
+ */
+TaskColumns buildColumns(const vector<Task>& tasks) {
+    TaskColumns columns;
+    columns.size = tasks.size();
+    columns.done.reserve(tasks.size());
+    columns.priority.reserve(tasks.size());
+    columns.due.reserve(tasks.size());
+    columns.created.reserve(tasks.size());
+    columns.textOffset.reserve(tasks.size() + 1);
+    for (const Task& task : tasks) {
+        columns.done.push_back(task.completed ? 1 : 0);
+        columns.priority.push_back(static_cast<uint8_t>(task.priority));
+        columns.due.push_back(dateNumber(task.due));
+        columns.created.push_back(dateNumber(task.created));
+        columns.textOffset.push_back(static_cast<uint32_t>(columns.text.size()));
+        columns.text += toLower(task.description);
+    }
+    columns.textOffset.push_back(static_cast<uint32_t>(columns.text.size()));
+    return columns;
+}
+
+/**
+ * @brief Keeps the selected rows whose column value satisfies a predicate.
+ *
+ * The loop is branch-free: every row is written to the output and the output
+ * length only advances when the predicate holds.
+ * @param column The column values.
+ * @param sel The selected row numbers.
+ * @param n The number of selected rows.
+ * @param out Receives the rows that pass.
+ * @param keep The predicate on a column value.
+ * @return The number of rows written to out.
+ */
+template <typename T, typename Predicate>
+size_t selectWhere(const T* column, const uint32_t* sel, size_t n, uint32_t* out, Predicate keep) {
+    size_t k = 0;
+    for (size_t j = 0; j < n; ++j) {
+        uint32_t row = sel[j];
+        out[k] = row;
+        k += keep(column[row]) ? 1 : 0;
+    }
+    return k;
+}
+
+/**
+ * @brief Keeps the selected rows whose set column value compares true against a constant.
+ * @param column The column values; 0 means unset and never matches.
+ * @param value The constant to compare with.
+ * @param op The comparison operator.
+ * @param sel The selected row numbers.
+ * @param n The number of selected rows.
+ * @param out Receives the rows that pass.
+ * @return The number of rows written to out.
+ */
+template <typename T>
+size_t selectCompare(const vector<T>& column, T value, Op op, const uint32_t* sel, size_t n, uint32_t* out) {
+    const T* data = column.data();
+    switch (op) {
+    case Op::Eq: return selectWhere(data, sel, n, out, [value](T v) { return v != 0 && v == value; });
+    case Op::Ne: return selectWhere(data, sel, n, out, [value](T v) { return v != 0 && v != value; });
+    case Op::Lt: return selectWhere(data, sel, n, out, [value](T v) { return v != 0 && v < value; });
+    case Op::Le: return selectWhere(data, sel, n, out, [value](T v) { return v != 0 && v <= value; });
+    case Op::Gt: return selectWhere(data, sel, n, out, [value](T v) { return v != 0 && v > value; });
+    case Op::Ge: return selectWhere(data, sel, n, out, [value](T v) { return v != 0 && v >= value; });
+    default: return 0;
+    }
+}
+
+/**
+ * @brief Evaluates a query expression over one batch of rows.
+ *
+ * Selection vectors carry the surviving row numbers from one operator to the
+ * next: `and` narrows the selection, `or` evaluates its right side only on the
+ * rows the left side rejected, and `not` keeps the rows its operand rejected.
+ * @param node The expression to evaluate.
+ * @param columns The task columns.
+ * @param sel The selected row numbers, in ascending order, at most BATCH_SIZE.
+ * @param n The number of selected rows.
+ * @param out Receives the matching rows in ascending order.
+ * @return The number of rows written to out.
+ */
+size_t selectBatch(const QueryNode& node, const TaskColumns& columns, const uint32_t* sel, size_t n, uint32_t* out) {
+    uint32_t left[BATCH_SIZE];
+    uint32_t rest[BATCH_SIZE];
+    switch (node.kind) {
+    case QueryNode::And: {
+        size_t k = selectBatch(*node.left, columns, sel, n, left);
+        return selectBatch(*node.right, columns, left, k, out);
+    }
+    case QueryNode::Or: {
+        size_t k = selectBatch(*node.left, columns, sel, n, left);
+        size_t r = set_difference(sel, sel + n, left, left + k, rest) - rest;
+        uint32_t right[BATCH_SIZE];
+        size_t m = selectBatch(*node.right, columns, rest, r, right);
+        return merge(left, left + k, right, right + m, out) - out;
+    }
+    case QueryNode::Not: {
+        size_t k = selectBatch(*node.left, columns, sel, n, left);
+        return set_difference(sel, sel + n, left, left + k, out) - out;
+    }
+    case QueryNode::Pred:
+        break;
+    }
+
+    switch (node.field) {
+    case Field::Status: {
+        uint8_t done = node.value == "done" ? 1 : 0;
+        bool equal = node.op == Op::Eq;
+        return selectWhere(columns.done.data(), sel, n, out, [done, equal](uint8_t v) { return (v == done) == equal; });
+    }
+    case Field::Priority:
+        return selectCompare<uint8_t>(columns.priority, static_cast<uint8_t>(node.value[0] - '0'), node.op, sel, n, out);
+    case Field::Due:
+        return selectCompare<int32_t>(columns.due, dateNumber(node.value), node.op, sel, n, out);
+    case Field::Created:
+        return selectCompare<int32_t>(columns.created, dateNumber(node.value), node.op, sel, n, out);
+    case Field::Tag:
+    case Field::Text: {
+        bool tag = node.field == Field::Tag;
+        bool like = node.op == Op::Like;
+        bool equal = node.op != Op::Ne;
+        string needle = tag ? "+" + node.value : node.value;
+        const char* text = columns.text.data();
+        const uint32_t* offset = columns.textOffset.data();
+        size_t k = 0;
+        for (size_t j = 0; j < n; ++j) {
+            const char* begin = text + offset[sel[j]];
+            const char* end = text + offset[sel[j] + 1];
+            bool keep = like ? search(begin, end, needle.begin(), needle.end()) != end
+                             : containsWord(begin, end, needle, tag) == equal;
+            out[k] = sel[j];
+            k += keep ? 1 : 0;
+        }
+        return k;
+    }
+    }
+    return 0;
+}
+
+/**
+ * @brief Filters candidate rows with the vectorized engine.
+ * @param where The filter expression, or null to keep every candidate.
+ * @param columns The task columns.
+ * @param candidates The candidate rows in ascending order.
+ * @return The matching rows in ascending order.
+ */
+vector<size_t> filterColumns(const QueryNode* where, const TaskColumns& columns, const vector<size_t>& candidates) {
+    if (!where) return candidates;
+    vector<size_t> results;
+    uint32_t sel[BATCH_SIZE];
+    uint32_t out[BATCH_SIZE];
+    for (size_t start = 0; start < candidates.size(); start += BATCH_SIZE) {
+        size_t n = min(BATCH_SIZE, candidates.size() - start);
+        for (size_t j = 0; j < n; ++j) sel[j] = static_cast<uint32_t>(candidates[start + j]);
+        size_t k = selectBatch(*where, columns, sel, n, out);
+        results.insert(results.end(), out, out + k);
+    }
+    return results;
+}
+
+/**
+ * @brief Filters candidate rows one Task at a time.
+ *
+ * This is the reference row-at-a-time path, kept for `--bench`.
+ * @param where The filter expression, or null to keep every candidate.
+ * @param tasks The task list.
+ * @param candidates The candidate rows.
+ * @return The matching rows in candidate order.
+ */
+vector<size_t> filterRows(const QueryNode* where, const vector<Task>& tasks, const vector<size_t>& candidates) {
+    vector<size_t> results;
+    for (size_t i : candidates) {
+        if (!where || matchesQuery(*where, tasks[i])) results.push_back(i);
+    }
+    return results;
+}
+
+/**
+ * @brief Returns the sort key of a task for a query's `order by` field.
+ * @param task The task.
+ * @param field The sort field.
+ * @return The key, empty if the task has no value for the field.
+ */
+string sortKey(const Task& task, Field field) {
+    switch (field) {
+    case Field::Status: return task.completed ? "1" : "0";
+    case Field::Tag: {
+        vector<string> tags = taskTags(task);
+        return tags.empty() ? "" : *min_element(tags.begin(), tags.end());
+    }
+    case Field::Text: return toLower(task.description);
+    case Field::Due: return task.due;
+    case Field::Created: return task.created;
+    case Field::Priority: return task.priority > 0 ? string(1, char('0' + task.priority)) : "";
+    }
+    return "";
+}
+
+/**
+ * @brief Runs a query and returns the positions of the matching tasks.
+ * @param tasks The task list.
+ * @param query The parsed query.
+ * @param index The index built from the same task list.
+ * @param columns The columns built from the same task list.
+ * @param plan The plan returned by planQuery().
+ * @return The 0-based positions of matching tasks, ordered and limited as requested.
+ */
+vector<size_t> runQuery(const vector<Task>& tasks, const Query& query, const TaskIndex& index,
+                        const TaskColumns& columns, const QueryPlan& plan) {
+    vector<size_t> results = filterColumns(query.where.get(), columns, candidateRows(index, plan));
+
+    if (query.ordered) {
+        // Unset values sort last in either direction; ties keep list order.
+        vector<string> keys(tasks.size());
+        for (size_t i : results) keys[i] = sortKey(tasks[i], query.orderBy);
+        auto before = [&](size_t a, size_t b) {
+            if (keys[a].empty() != keys[b].empty()) return keys[b].empty();
+            return query.descending ? keys[a] > keys[b] : keys[a] < keys[b];
+        };
+        if (query.limit < results.size()) {
+            partial_sort(results.begin(), results.begin() + query.limit, results.end(), [&](size_t a, size_t b) {
+                return before(a, b) || (!before(b, a) && a < b);
+            });
+        } else {
+            stable_sort(results.begin(), results.end(), before);
+        }
+    }
+    if (query.limit < results.size()) results.resize(query.limit);
+    return results;
+}
+
+/**
+ * @brief Describes a query plan for `--explain`.
+ * @param query The parsed query.
+ * @param plan The chosen plan.
+ * @return A multi-line description of the plan and its estimated cost.
+ */
+string explainQuery(const Query& query, const QueryPlan& plan) {
+    static const char* accessNames[] = {"Full scan over task store", "Status bitmap", "Tag bitmap",
+                                        "Inverted word index", "Due-date index"};
+    static const char* fieldNames[] = {"status", "tag", "text", "due", "created", "priority"};
+    stringstream ss;
+    ss << "Plan:" << endl;
+    ss << "  " << accessNames[plan.access];
+    if (plan.driver) ss << " on " << formatQuery(*plan.driver);
+    ss << " (est. " << plan.estimatedRows << " rows)" << endl;
+    if (query.where) ss << "  Filter: " << formatQuery(*query.where) << endl;
+    if (query.ordered) {
+        ss << "  Order by: " << fieldNames[static_cast<int>(query.orderBy)] << (query.descending ? " desc" : " asc") << endl;
+    }
+    if (query.limit != string::npos) ss << "  Limit: " << query.limit << endl;
+    ss << "  Execution: vectorized, " << BATCH_SIZE << "-row batches" << endl;
+    ss << "Estimated cost: " << plan.estimatedCost << " (full scan: " << plan.scanCost << ")" << endl;
+    return ss.str();
+}
+
+/**
+ * @brief Times the row-at-a-time and vectorized filters over a full scan.
+ *
+ * Each engine runs repeatedly for at least 200 ms and its throughput is printed.
+ * @param tasks The task list.
+ * @param query The parsed query.
+ * @param columns The columns built from the same task list.
+ */
+void benchQuery(const vector<Task>& tasks, const Query& query, const TaskColumns& columns) {
+    vector<size_t> all(tasks.size());
+    for (size_t i = 0; i < all.size(); ++i) all[i] = i;
+    auto measure = [&](const char* name, auto filter) {
+        using Clock = chrono::steady_clock;
+        size_t runs = 0, matches = 0;
+        Clock::time_point start = Clock::now();
+        double seconds = 0;
+        do {
+            matches = filter().size();
+            ++runs;
+            seconds = chrono::duration<double>(Clock::now() - start).count();
+        } while (seconds < 0.2);
+        double rowsPerSecond = seconds > 0 ? all.size() * runs / seconds : 0;
+        cout << name << ": " << matches << " matches, " << static_cast<size_t>(rowsPerSecond / 1e6 * 10) / 10.0
+             << " M rows/s over " << runs << " runs" << endl;
+    };
+    measure("Row-at-a-time", [&] { return filterRows(query.where.get(), tasks, all); });
+    measure("Vectorized   ", [&] { return filterColumns(query.where.get(), columns, all); });
+}
+
+/**
+ * @brief The generation counters kept by the result cache.
+ *
+ * The first six follow the Field order and change whenever the data behind that
+ * field changes; GenRemoved changes whenever a task is removed.
+ */
+enum Generation { GenStatus, GenTag, GenText, GenDue, GenCreated, GenPriority, GenRemoved, GenCount };
+
+std::string CACHE_FILENAME = getExecutableDirectory() + "\\todo.cache"; /**< File path of the query result cache */
+
+const size_t CACHE_CAPACITY = 32;     /**< The maximum number of cached results. */
+const size_t CACHE_MAX_ROWS = 10000;  /**< Results with more rows than this are not cached. */
+
+/**
+ * @struct ResultCache
+ * @brief A bounded LRU cache of query results, persisted between runs.
+ *
+ * Entries are keyed by the normalized query plus the generations of the fields
+ * it reads, so a mutation only invalidates the queries that depend on what it
+ * changed. Results are stored as (list position, task ID) pairs.
+ */
+struct ResultCache {
+    bool loaded = false;                               /**< Whether the cache file has been read. */
+    string stamp;                                      /**< Size and modification time of the task file the entries belong to. */
+    unsigned long long generations[GenCount] = {};     /**< The current generation of each field. */
+    unsigned long long hits = 0;                       /**< The number of lookups answered from the cache. */
+    unsigned long long misses = 0;                     /**< The number of lookups that ran the query. */
+    vector<pair<string, vector<pair<size_t, unsigned>>>> entries; /**< The cached results, most recently used first. */
+};
+
+ResultCache resultCache; /**< The result cache, loaded on first use by loadCache(). */
+bool cacheChanged = false; /**< Whether the entries or generations have changed since the cache was loaded. */
+bool residentSession = false; /**< Set while `todo shell` keeps the list loaded; only then are query results cached and trigrams indexed. */
+
+/**
+ * @brief Describes the current state of the task file.
+ * @return The size and modification time of the task file, or an empty string if it does not exist.
+ */
+string taskFileStamp() {
+    error_code ec;
+    uintmax_t size = filesystem::file_size(FILENAME, ec);
+    if (ec) return "";
+    auto modified = filesystem::last_write_time(FILENAME, ec);
+    return to_string(size) + ":" + to_string(modified.time_since_epoch().count());
+}
+
+/**
+ * @brief Loads the result cache unless it is already loaded.
+ *
+ * Entries are dropped if the task file changed without going through this program.
+ */
+void loadCache() {
+    if (resultCache.loaded) return;
+    resultCache.loaded = true;
+    ifstream file(CACHE_FILENAME);
+    string line;
+    while (getline(file, line)) {
+        size_t tab = line.find('\t');
+        if (tab == string::npos) {
+            stringstream ss(line);
+            string key;
+            ss >> key;
+            if (key == "stamp") {
+                ss >> resultCache.stamp;
+            } else if (key == "generations") {
+                for (auto& generation : resultCache.generations) ss >> generation;
+            } else if (key == "hits") {
+                ss >> resultCache.hits >> key >> resultCache.misses;
+            }
+            continue;
+        }
+        vector<pair<size_t, unsigned>> rows;
+        stringstream ss(line.substr(tab + 1));
+        size_t position;
+        unsigned id;
+        char colon;
+        while (ss >> position >> colon >> id) rows.push_back({position, id});
+        resultCache.entries.push_back({line.substr(0, tab), rows});
+    }
+    if (resultCache.stamp != taskFileStamp()) resultCache.entries.clear();
+}
+
+/**
+ * @brief Writes the result cache to the cache file.
+ */
+void saveCache() {
+    ofstream file(CACHE_FILENAME);
+    if (file.is_open()) {
+        file << "stamp " << taskFileStamp() << "\n";
+        file << "generations";
+        for (auto generation : resultCache.generations) file << " " << generation;
+        file << "\nhits " << resultCache.hits << " misses " << resultCache.misses << "\n";
+        for (const auto& entry : resultCache.entries) {
+            file << entry.first << "\t";
+            for (const auto& row : entry.second) file << row.first << ":" << row.second << " ";
+            file << "\n";
+        }
+        file.close();
+    }
+    cacheChanged = false;
+}
+
+/**
+ * @brief Advances the generations affected by a task change.
+ *
+ * A new task can match any query, so an addition advances every field. Completing
+ * a task only changes its status and rescheduling only its due date. A removal only matters to queries with `limit`,
+ * since removed IDs are skipped when a cached result is shown.
+ * @param change The kind of change.
+ */
+void advanceGenerations(Change change) {
+    loadCache();
+    if (change == Change::Added) {
+        for (int field = GenStatus; field <= GenPriority; ++field) ++resultCache.generations[field];
+    } else if (change == Change::Completed) {
+        ++resultCache.generations[GenStatus];
+    } else if (change == Change::Rescheduled) {
+        ++resultCache.generations[GenDue];
+    } else {
+        ++resultCache.generations[GenRemoved];
+    }
+    cacheChanged = true;
+}
+
+/**
+ * @brief Collects the fields a query expression reads.
+ * @param node The expression.
+ * @param fields Receives true for every field the expression reads.
+ */
+void collectFields(const QueryNode& node, bool fields[]) {
+    if (node.kind == QueryNode::Pred) {
+        fields[static_cast<int>(node.field)] = true;
+        return;
+    }
+    collectFields(*node.left, fields);
+    if (node.right) collectFields(*node.right, fields);
+}
+
+/**
+ * @brief Builds the cache key of a query.
+ *
+ * The key is the normalized query followed by the generation of every field the
+ * query filters or sorts on, plus the removal generation if it has a limit.
+ * @param query The parsed query.
+ * @return The cache key.
+ */
+string cacheKey(const Query& query) {
+    static const char* fieldNames[] = {"status", "tag", "text", "due", "created", "priority"};
+    bool fields[GenCount] = {};
+    stringstream ss;
+    if (query.where) {
+        ss << formatQuery(*query.where);
+        collectFields(*query.where, fields);
+    }
+    if (query.ordered) {
+        ss << " order by " << fieldNames[static_cast<int>(query.orderBy)] << (query.descending ? " desc" : " asc");
+        fields[static_cast<int>(query.orderBy)] = true;
+    }
+    if (query.limit != string::npos) {
+        ss << " limit " << query.limit;
+        fields[GenRemoved] = true;
+    }
+    ss << " @";
+    for (int field = 0; field < GenCount; ++field) {
+        ss << " " << (fields[field] ? to_string(resultCache.generations[field]) : "-");
+    }
+    string key = ss.str();
+    replace(key.begin(), key.end(), '\t', ' ');
+    return key;
+}
+
+/**
+ * @brief Looks up a cached result and marks it as most recently used.
+ *
+ * The hit and miss counters are only kept in memory here; they are written
+ * with the entries, so a lookup alone never rewrites the cache file.
+ * @param key The cache key.
+ * @return The cached (position, ID) rows, or null on a miss.
+ */
+const vector<pair<size_t, unsigned>>* cacheLookup(const string& key) {
+    auto& entries = resultCache.entries;
+    for (size_t i = 0; i < entries.size(); ++i) {
+        if (entries[i].first == key) {
+            rotate(entries.begin(), entries.begin() + i, entries.begin() + i + 1);
+            ++resultCache.hits;
+            return &entries.front().second;
+        }
+    }
+    ++resultCache.misses;
+    return nullptr;
+}
+
+/**
+ * @brief Stores a query result as the most recently used entry, evicting the least recently used.
+ * @param tasks The task list.
+ * @param key The cache key.
+ * @param results The 0-based positions of the result tasks.
+ */
+void cacheStore(const vector<Task>& tasks, const string& key, const vector<size_t>& results) {
+    if (results.size() > CACHE_MAX_ROWS) return;
+    vector<pair<size_t, unsigned>> rows;
+    for (size_t i : results) rows.push_back({i, tasks[i].id});
+    resultCache.entries.insert(resultCache.entries.begin(), {key, rows});
+    if (resultCache.entries.size() > CACHE_CAPACITY) resultCache.entries.resize(CACHE_CAPACITY);
+    cacheChanged = true;
+}
+
+/**
+ * @brief Resolves cached (position, ID) rows to current list positions.
+ *
+ * Positions are trusted when the task there still has the cached ID; otherwise
+ * the ID is looked up, and IDs of removed tasks are skipped.
+ * @param tasks The task list.
+ * @param rows The cached rows.
+ * @return The current 0-based positions of the result tasks.
+ */
+vector<size_t> resolveCachedRows(const vector<Task>& tasks, const vector<pair<size_t, unsigned>>& rows) {
+    vector<size_t> results;
+    unordered_map<unsigned, size_t> positions;
+    for (const auto& row : rows) {
+        if (row.first < tasks.size() && tasks[row.first].id == row.second) {
+            results.push_back(row.first);
+            continue;
+        }
+        if (positions.empty()) {
+            for (size_t i = 0; i < tasks.size(); ++i) positions[tasks[i].id] = i;
+        }
+        auto it = positions.find(row.second);
+        if (it != positions.end()) results.push_back(it->second);
+    }
+    return results;
+}
+
+/**
+ * @brief Prints the hit rate of the result cache.
+ */
+void printCacheStats() {
+    loadCache();
+    unsigned long long lookups = resultCache.hits + resultCache.misses;
+    cout << "Result cache: " << resultCache.entries.size() << "/" << CACHE_CAPACITY << " entries, "
+         << resultCache.hits << " hits, " << resultCache.misses << " misses";
+    if (lookups > 0) cout << " (" << (resultCache.hits * 1000 / lookups) / 10.0 << "% hit rate)";
+    cout << endl;
+}
+
+std::string STATS_FILENAME = getExecutableDirectory() + "\\todo.stats"; /**< File path of the task statistics */
+
+/**
+ * @struct TaskStats
+ * @brief Task counts maintained incrementally as the list changes.
+ *
+ * The counts are stored in a small file next to the task file and adjusted by
+ * every change, so `todo stats` never reads the task list.
+ */
+struct TaskStats {
+    bool loaded = false;                             /**< Whether the stats file has been read. */
+    bool valid = false;                              /**< Whether the counts match the current task file. */
+    long long total = 0;                             /**< The number of tasks. */
+    long long done = 0;                              /**< The number of completed tasks. */
+    map<string, pair<long long, long long>> tags;    /**< Per tag: (tasks, completed tasks). */
+    map<string, pair<long long, long long>> days;    /**< Per day: (tasks added, tasks completed). */
+};
+
+TaskStats taskStats; /**< The statistics, loaded on first use by loadStats(). */
+
+/**
+ * @brief Loads the statistics unless they are already loaded.
+ *
+ * The counts are only trusted if the task file has not changed since they were written.
+ */
+void loadStats() {
+    if (taskStats.loaded) return;
+    taskStats.loaded = true;
+    ifstream file(STATS_FILENAME);
+    string key, stamp;
+    while (file >> key) {
+        if (key == "stamp") {
+            file >> stamp;
+        } else if (key == "total") {
+            file >> taskStats.total >> taskStats.done;
+        } else if (key == "day") {
+            string day;
+            file >> day;
+            file >> taskStats.days[day].first >> taskStats.days[day].second;
+        } else if (key == "tag") {
+            string tag;
+            file >> tag;
+            file >> taskStats.tags[tag].first >> taskStats.tags[tag].second;
+        }
+    }
+    taskStats.valid = file.eof() && !stamp.empty() && stamp == taskFileStamp();
+}
+
+/**
+ * @struct CatalogEntry
+ * @brief The summary of one list in the catalog.
+ */
+struct CatalogEntry {
+    long long total = 0;   /**< The number of tasks. */
+    long long done = 0;    /**< The number of completed tasks. */
+    string updated;        /**< The date of the last change. */
+};
+
+/**
+ * @brief Reads the catalog of lists.
+ *
+ * The catalog is a small text file next to the executable with one
+ * `list NAME TOTAL DONE UPDATED` line per list.
+ * @return The entries, keyed by list name.
+ */
+map<string, CatalogEntry> loadCatalog() {
+    map<string, CatalogEntry> catalog;
+    ifstream file(CATALOG_FILENAME);
+    string key, name;
+    while (file >> key >> name) {
+        CatalogEntry& entry = catalog[name];
+        file >> entry.total >> entry.done >> entry.updated;
+    }
+    return catalog;
+}
+
+/**
+ * @brief Records the counts of the selected list in the catalog.
+ *
+ * Called whenever the statistics are saved, so the catalog follows every change.
+ * Processes working on other lists may save at the same time, so the catalog
+ * is read and rewritten while holding a lock file, and replaced through a
+ * temporary file. If the lock cannot be taken within a second the catalog is
+ * left as it is; the entry is brought up to date by the next save of the list.
+ * @param changed false if the counts were only recounted, which keeps the date of the last change.
+ */
+void saveCatalogEntry(bool changed) {
+    if (!filesystem::exists(FILENAME)) return;  // e.g. `stats` on a list that was never created
+    string lockPath = CATALOG_FILENAME + ".lock";
+    HANDLE lock = INVALID_HANDLE_VALUE;
+    for (int attempt = 0; attempt < 100 && lock == INVALID_HANDLE_VALUE; ++attempt) {
+        lock = CreateFileA(lockPath.c_str(), GENERIC_WRITE, 0, nullptr, CREATE_ALWAYS, FILE_FLAG_DELETE_ON_CLOSE, nullptr);
+        if (lock == INVALID_HANDLE_VALUE) this_thread::sleep_for(chrono::milliseconds(10));
+    }
+    if (lock == INVALID_HANDLE_VALUE) return;  // writing without it could lose another process's entry
+    map<string, CatalogEntry> catalog = loadCatalog();
+    CatalogEntry& entry = catalog[listName];
+    entry.total = taskStats.total;
+    entry.done = taskStats.done;
+    if (changed || entry.updated.empty()) entry.updated = today();
+    string temp = CATALOG_FILENAME + ".tmp";
+    ofstream file(temp);
+    for (const auto& list : catalog) {
+        file << "list " << list.first << " " << list.second.total << " " << list.second.done << " " << list.second.updated << "\n";
+    }
+    file.close();
+    error_code ec;
+    if (file) filesystem::rename(temp, CATALOG_FILENAME, ec);
+    if (!file || ec) filesystem::remove(temp, ec);
+    CloseHandle(lock);  // deletes the lock file
+}
+
+/**
+ * @brief Prints the summary of every list, reading only the catalog.
+ */
+void printLists() {
+    map<string, CatalogEntry> catalog = loadCatalog();
+    if (catalog.empty() && outputFormat == OutputFormat::Text) {
+        cout << "No lists found." << endl;
+        return;
+    }
+    for (const auto& list : catalog) {
+        const CatalogEntry& entry = list.second;
+        if (outputFormat != OutputFormat::Text) {
+            JsonRecord().field("list", list.first).field("tasks", entry.total).field("open", entry.total - entry.done)
+                .field("done", entry.done).field("updated", entry.updated);
+            continue;
+        }
+        cout << list.first << ": " << entry.total << " tasks (" << entry.total - entry.done << " open, "
+             << entry.done << " done), updated " << entry.updated << endl;
+    }
+}
+
+/**
+ * @brief Writes the statistics to the stats file.
+ * @param changed false if the statistics were only recounted, not changed.
+ */
+void saveStats(bool changed = true) {
+    ofstream file(STATS_FILENAME);
+    if (file.is_open()) {
+        file << "stamp " << taskFileStamp() << "\n";
+        file << "total " << taskStats.total << " " << taskStats.done << "\n";
+        for (const auto& tag : taskStats.tags) {
+            file << "tag " << tag.first << " " << tag.second.first << " " << tag.second.second << "\n";
+        }
+        for (const auto& day : taskStats.days) {
+            file << "day " << day.first << " " << day.second.first << " " << day.second.second << "\n";
+        }
+        file.close();
+        saveCatalogEntry(changed);
+    }
+}
+
+/**
+ * @brief Recounts the statistics from a task list.
+ *
+ * Only needed when the task file was changed outside this program; the
+ * per-day history is kept, since it cannot be recovered from the list.
+ * @param tasks The vector of tasks.
+ */
+void rebuildStats(const vector<Task>& tasks) {
+    taskStats.total = static_cast<long long>(tasks.size());
+    taskStats.done = 0;
+    taskStats.tags.clear();
+    for (const Task& task : tasks) {
+        taskStats.done += task.completed;
+        for (const string& tag : taskTags(task)) {
+            ++taskStats.tags[tag].first;
+            taskStats.tags[tag].second += task.completed;
+        }
+    }
+    taskStats.valid = true;
+}
+
+/**
+ * @brief Adjusts the statistics for one task change.
+ * @param change The kind of change.
+ * @param task The task after the change (before it, for removals).
+ */
+void updateStats(Change change, const Task& task) {
+    loadStats();
+    if (!taskStats.valid) return;  // recounted by saveTasks()
+    long long delta = change == Change::Removed ? -1 : 1;
+    if (change == Change::Added || change == Change::Removed) {
+        taskStats.total += delta;
+        taskStats.done += task.completed ? delta : 0;
+        for (const string& tag : taskTags(task)) {
+            taskStats.tags[tag].first += delta;
+            taskStats.tags[tag].second += task.completed ? delta : 0;
+            if (taskStats.tags[tag].first == 0) taskStats.tags.erase(tag);
+        }
+        if (change == Change::Added) ++taskStats.days[today()].first;
+    }
+    if (change == Change::Completed || (change == Change::Added && task.completed)) {
+        if (change == Change::Completed) {
+            ++taskStats.done;
+            for (const string& tag : taskTags(task)) ++taskStats.tags[tag].second;
+        }
+        ++taskStats.days[today()].second;
+    }
+}
+
+/**
+ * @brief Prints the task statistics.
+ *
+ * Reads only the stats file unless the task file was changed outside this
+ * program, in which case the counts are rebuilt once.
+ */
+void printStats() {
+    loadStats();
+    if (!taskStats.valid) {
+        vector<Task> tasks;
+        loadTasksFromFile(tasks);
+        rebuildStats(tasks);
+        saveStats(false);
+    }
+    string last = today();
+    string first = dateFromDays(dayNumber(last) - 6);
+    if (outputFormat != OutputFormat::Text) {
+        JsonRecord().field("tasks", taskStats.total).field("open", taskStats.total - taskStats.done).field("done", taskStats.done);
+        for (const auto& tag : taskStats.tags) {
+            JsonRecord().field("tag", tag.first).field("tasks", tag.second.first).field("done", tag.second.second);
+        }
+        for (auto it = taskStats.days.lower_bound(first); it != taskStats.days.end() && it->first <= last; ++it) {
+            JsonRecord().field("date", it->first).field("added", it->second.first).field("completed", it->second.second);
+        }
+        loadCache();
+        JsonRecord()
+            .field("cache_entries", static_cast<long long>(resultCache.entries.size()))
+            .field("cache_hits", static_cast<long long>(resultCache.hits))
+            .field("cache_misses", static_cast<long long>(resultCache.misses));
+        return;
+    }
+    cout << "Tasks: " << taskStats.total << " (" << taskStats.total - taskStats.done << " open, "
+         << taskStats.done << " done)" << endl;
+    if (taskStats.total > 0) {
+        cout << "Completion rate: " << (taskStats.done * 1000 / taskStats.total) / 10.0 << "%" << endl;
+    }
+    if (!taskStats.tags.empty()) {
+        cout << "Tags:" << endl;
+        for (const auto& tag : taskStats.tags) {
+            cout << "  +" << tag.first << ": " << tag.second.first << " (" << tag.second.second << " done)" << endl;
+        }
+    }
+    long long completed = 0;
+    cout << "Completed per day:" << endl;
+    for (string day = first; day <= last; day = dateFromDays(dayNumber(day) + 1)) {
+        auto it = taskStats.days.find(day);
+        long long count = it == taskStats.days.end() ? 0 : it->second.second;
+        completed += count;
+        cout << "  " << day << ": " << count << endl;
+    }
+    cout << "  Average: " << (completed * 10 / 7) / 10.0 << " per day" << endl;
+    printCacheStats();
+}
+
+/**
+ * @brief Runs a query against the task list and prints the matching tasks.
+ *
+ * Tasks keep their list numbers so they can be passed on to `done` and `remove`.
+ * In `todo shell` results are served from the result cache when the fields the
+ * query depends on have not changed since it was last run. A single command
+ * loads the whole list anyway, so it runs the query rather than read and
+ * rewrite the cache file.
+ * @param tasks The task list.
+ * @param text The query text.
+ * @param explain If true, the chosen plan is printed before the results.
+ * @param bench If true, the filter is timed with both execution engines before the results.
+ * @return false if the query could not be parsed.
+ */
+bool queryTasks(const vector<Task>& tasks, const string& text, bool explain, bool bench) {
+    Query query;
+    string error;
+    if (!parseQuery(text, query, error)) {
+        cout << "Invalid query: " << error << endl;
+        return false;
+    }
+    bool cache = residentSession && !bench;
+    if (cache) loadCache();
+    string key = cache ? cacheKey(query) : "";
+    const vector<pair<size_t, unsigned>>* cached = cache ? cacheLookup(key) : nullptr;
+    vector<size_t> results;
+    if (cached) {
+        if (explain) cout << "Plan: cached result for " << key << endl;
+        results = resolveCachedRows(tasks, *cached);
+    } else {
+        TaskIndex index = buildIndex(tasks);
+        QueryPlan plan = planQuery(query, index);
+        TaskColumns columns = buildColumns(tasks);
+        if (explain) cout << explainQuery(query, plan);
+        if (bench) benchQuery(tasks, query, columns);
+        results = runQuery(tasks, query, index, columns, plan);
+        if (cache) cacheStore(tasks, key, results);
+    }
+    if (results.empty()) {
+        cout << "No matching tasks." << endl;
+    }
+    for (size_t i : results) {
+        printTask(tasks[i], i + 1);
+    }
+    return true;
+}
+
+/**
+ * @brief Builds the query run by `search`.
+ * @param text The search text.
+ * @return A query matching the tasks that contain every word of the text.
+ */
+string searchQuery(const string& text) {
+    string words;
+    for (const string& word : tokenize(text)) {
+        words += (words.empty() ? "text:" : " text:") + word;
+    }
+    return words.empty() ? "\"" + text + "\"" : words;
+}
+
+/**
+ * @struct SavedView
+ * @brief A named query whose result is stored and kept up to date as tasks change.
+ *
+ * The result is kept as (sort key, task ID) rows in view order, so showing a
+ * view does not evaluate the query again.
+ */
+struct SavedView {
+    string name;                        /**< The view name. */
+    string text;                        /**< The query text as saved by the user. */
+    Query query;                        /**< The parsed query. */
+    vector<pair<string, unsigned>> rows; /**< The materialized result as (sort key, task ID), in view order. */
+};
+
+std::string VIEWS_FILENAME = getExecutableDirectory() + "\\todo.views"; /**< File path of the saved views */
+
+bool viewsChanged = false; /**< Whether the saved views must be written back by saveTasks(). */
+
+vector<SavedView> savedViews; /**< The saved views, loaded by loadViews(). */
+
+/**
+ * @brief Orders two view rows the way the view's query orders its results.
+ *
+ * Unset keys sort last in either direction; ties are broken by task ID.
+ * @param query The view query.
+ * @param a The first row.
+ * @param b The second row.
+ * @return true if a comes before b.
+ */
+bool viewRowBefore(const Query& query, const pair<string, unsigned>& a, const pair<string, unsigned>& b) {
+    if (query.ordered && a.first != b.first) {
+        if (a.first.empty() != b.first.empty()) return b.first.empty();
+        return query.descending ? a.first > b.first : a.first < b.first;
+    }
+    return a.second < b.second;
+}
+
+/**
+ * @brief Loads the saved views from the views file.
+ *
+ * Each view starts with a line `@<name>\t<query>` followed by one `<id>\t<sort key>`
+ * line per task in the result.
+ */
+void loadViews() {
+    ifstream file(VIEWS_FILENAME);
+    string line;
+    string error;
+    while (getline(file, line)) {
+        size_t tab = line.find('\t');
+        if (!line.empty() && line[0] == '@') {
+            SavedView view;
+            view.name = line.substr(1, tab == string::npos ? string::npos : tab - 1);
+            view.text = tab == string::npos ? "" : line.substr(tab + 1);
+            if (parseQuery(view.text, view.query, error)) {
+                savedViews.push_back(move(view));
+            }
+        } else if (!savedViews.empty() && tab != string::npos) {
+            savedViews.back().rows.push_back({line.substr(tab + 1), static_cast<unsigned>(atoi(line.c_str()))});
+        }
+    }
+}
+
+void saveViews() {
+    ofstream file(VIEWS_FILENAME);
+    if (file.is_open()) {
+        for (const SavedView& view : savedViews) {
+            file << "@" << view.name << "\t" << view.text << "\n";
+            for (const auto& row : view.rows) {
+                file << row.second << "\t" << row.first << "\n";
+            }
+        }
+        file.close();
+    }
+    viewsChanged = false;
+}
+
+/**
+ * @brief Applies a task change to the saved views.
+ *
+ * Only the changed task is evaluated against each view query; its row is then
+ * removed from or inserted at its sorted position in the stored result.
+ * @param change The kind of change.
+ * @param task The task after the change (before it, for removals).
+ */
+void updateViews(Change change, const Task& task) {
+    for (SavedView& view : savedViews) {
+        auto row = find_if(view.rows.begin(), view.rows.end(),
+                           [&](const pair<string, unsigned>& r) { return r.second == task.id; });
+        bool present = row != view.rows.end();
+        bool member = change != Change::Removed && (!view.query.where || matchesQuery(*view.query.where, task));
+        if (present) {
+            view.rows.erase(row);
+        }
+        if (member) {
+            pair<string, unsigned> entry(view.query.ordered ? sortKey(task, view.query.orderBy) : "", task.id);
+            auto pos = upper_bound(view.rows.begin(), view.rows.end(), entry,
+                                   [&](const pair<string, unsigned>& a, const pair<string, unsigned>& b) {
+                                       return viewRowBefore(view.query, a, b);
+                                   });
+            view.rows.insert(pos, entry);
+        }
+        viewsChanged = viewsChanged || present || member;
+    }
+}
+
+/**
+ * @brief Finds a saved view by name.
+ * @param name The view name.
+ * @return The view, or null if there is none with that name.
+ */
+SavedView* findView(const string& name) {
+    for (SavedView& view : savedViews) {
+        if (view.name == name) return &view;
+    }
+    return nullptr;
+}
+
+/**
+ * @brief Saves a query as a view and materializes its result.
+ *
+ * An existing view with the same name is replaced. Views cannot use `limit`,
+ * because a limited result cannot be maintained one task at a time.
+ * @param tasks The task list.
+ * @param name The view name.
+ * @param text The query text.
+ * @return false if the name or the query is invalid.
+ */
+bool saveView(const vector<Task>& tasks, const string& name, const string& text) {
+    SavedView view;
+    string error;
+    if (name.empty() || name == "save" || name == "drop" || name.find_first_of("@\t") != string::npos) {
+        cout << "Invalid view name." << endl;
+        return false;
+    }
+    if (!parseQuery(text, view.query, error)) {
+        cout << "Invalid query: " << error << endl;
+        return false;
+    }
+    if (view.query.limit != string::npos) {
+        cout << "Views cannot use 'limit'." << endl;
+        return false;
+    }
+    view.name = name;
+    view.text = text;
+    TaskIndex index = buildIndex(tasks);
+    vector<size_t> results = runQuery(tasks, view.query, index, buildColumns(tasks), planQuery(view.query, index));
+    for (size_t i : results) {
+        view.rows.push_back({view.query.ordered ? sortKey(tasks[i], view.query.orderBy) : "", tasks[i].id});
+    }
+    if (SavedView* existing = findView(name)) {
+        *existing = move(view);
+    } else {
+        savedViews.push_back(move(view));
+    }
+    saveViews();
+    cout << "Saved view '" << name << "' with " << results.size() << " tasks." << endl;
+    return true;
+}
+
+/**
+ * @brief Prints the stored result of a saved view.
+ *
+ * Tasks keep their list numbers so they can be passed on to `done` and `remove`.
+ * @param tasks The task list.
+ * @param name The view name.
+ * @return false if there is no view with that name.
+ */
+bool showView(const vector<Task>& tasks, const string& name) {
+    SavedView* view = findView(name);
+    if (!view) {
+        cout << "No view named '" << name << "'." << endl;
+        return false;
+    }
+    unordered_map<unsigned, size_t> positions;
+    for (size_t i = 0; i < tasks.size(); ++i) positions[tasks[i].id] = i;
+    if (view->rows.empty()) {
+        cout << "No matching tasks." << endl;
+    }
+    for (const auto& row : view->rows) {
+        auto it = positions.find(row.second);
+        if (it != positions.end()) printTask(tasks[it->second], it->second + 1);
+    }
+    return true;
+}
+
+/**
+ * @brief Lists the saved views with their queries and result sizes.
+ */
+void listViews() {
+    if (savedViews.empty()) {
+        cout << "No saved views." << endl;
+    }
+    for (const SavedView& view : savedViews) {
+        cout << view.name << " (" << view.rows.size() << " tasks): " << view.text << endl;
+    }
+}
+
+std::string TIMELOG_FILENAME = getExecutableDirectory() + "\\todo.timelog"; /**< File path of the interval log */
+std::string TIMESUM_FILENAME = getExecutableDirectory() + "\\todo.timesum"; /**< File path of the time aggregates */
+
+const string TIME_TOTAL = "all tasks"; /**< The aggregates key of the time of all tasks; tags cannot contain spaces. */
+
+/**
+ * @brief Running per-day totals of tracked time, keyed by tag.
+ *
+ * For every tag (and TIME_TOTAL for all tasks) the vector holds (day, cumulative
+ * seconds up to and including that day) pairs in day order, so the time spent in
+ * any date range is the difference of two lookups.
+ */
+map<string, vector<pair<string, long long>>> timeSums;
+
+string pendingTimeLog;        /**< Intervals stopped since the last save, appended to the interval log by saveTimeLog(). */
+bool timeSumsChanged = false; /**< Whether the time aggregates must be written back by saveTimeLog(). */
+
+/**
+ * @brief Formats a number of seconds as hours and minutes.
+ * @param seconds The duration.
+ * @return The duration, e.g. `2h 05m`.
+ */
+string formatDuration(long long seconds) {
+    char buf[32];
+    snprintf(buf, sizeof(buf), "%lldh %02lldm", seconds / 3600, seconds / 60 % 60);
+    return buf;
+}
+
+/**
+ * @brief Returns the local date of a point in time.
+ * @param when The point in time.
+ * @return The date in YYYY-MM-DD format.
+ */
+string localDate(time_t when) {
+    tm local = *localtime(&when);
+    char buf[11];
+    strftime(buf, sizeof(buf), "%Y-%m-%d", &local);
+    return buf;
+}
+
+/**
+ * @brief Loads the time aggregates from the aggregates file.
+ *
+ * Each line holds `<day> <cumulative seconds> <tag>`. Files written by older
+ * versions keep the time of all tasks under `*`.
+ */
+void loadTimeSums() {
+    if (!timeSums.empty()) return;
+    ifstream file(TIMESUM_FILENAME);
+    string day, tag;
+    long long total;
+    while (file >> day >> total && getline(file, tag)) {
+        timeSums[trim(tag)].push_back({day, total});
+    }
+    auto old = timeSums.find("*");
+    if (old != timeSums.end() && timeSums.count(TIME_TOTAL) == 0) {
+        timeSums[TIME_TOTAL] = move(old->second);
+        timeSums.erase(old);
+    }
+}
+
+/**
+ * @brief Writes the time aggregates to the aggregates file.
+ */
+void saveTimeSums() {
+    ofstream file(TIMESUM_FILENAME);
+    if (file.is_open()) {
+        for (const auto& sums : timeSums) {
+            for (const auto& entry : sums.second) {
+                file << entry.first << " " << entry.second << " " << sums.first << "\n";
+            }
+        }
+        file.close();
+    }
+}
+
+/**
+ * @brief Writes the stopped intervals and the time aggregates.
+ *
+ * Called by saveSidecars() after the task file was written, so time is only
+ * booked for timers whose stop was saved.
+ */
+void saveTimeLog() {
+    if (!pendingTimeLog.empty()) {
+        ofstream log(TIMELOG_FILENAME, ios::app);
+        log << pendingTimeLog;
+        pendingTimeLog.clear();
+    }
+    if (timeSumsChanged) {
+        saveTimeSums();
+        timeSumsChanged = false;
+    }
+}
+
+/**
+ * @brief Adds tracked time on a day to the running totals of a tag.
+ *
+ * Days are usually today, so only the last entry is touched; time added to an
+ * earlier day also shifts the totals of the days after it.
+ * @param sums The running totals of one tag.
+ * @param day The day the time was spent on.
+ * @param seconds The time spent.
+ */
+void addTimeSum(vector<pair<string, long long>>& sums, const string& day, long long seconds) {
+    auto it = lower_bound(sums.begin(), sums.end(), make_pair(day, LLONG_MIN));
+    if (it == sums.end() || it->first != day) {
+        long long before = it == sums.begin() ? 0 : prev(it)->second;
+        it = sums.insert(it, {day, before});
+    }
+    for (; it != sums.end(); ++it) {
+        it->second += seconds;
+    }
+}
+
+/**
+ * @brief Returns the time tracked for a tag in a date range.
+ * @param tag The tag, or `*` for all tasks.
+ * @param from The first day of the range as YYYY-MM-DD.
+ * @param to The last day of the range as YYYY-MM-DD.
+ * @return The number of seconds tracked in [from, to].
+ */
+long long timeBetween(const string& tag, const string& from, const string& to) {
+    auto sums = timeSums.find(tag);
+    if (sums == timeSums.end()) return 0;
+    auto totalUpTo = [&](const string& day) -> long long {
+        auto it = upper_bound(sums->second.begin(), sums->second.end(), make_pair(day, LLONG_MAX));
+        return it == sums->second.begin() ? 0 : prev(it)->second;
+    };
+    return totalUpTo(to) - totalUpTo(dateFromDays(dayNumber(from) - 1));
+}
+
+/**
+ * @brief Starts the timer of a task.
+ * @param tasks The vector of tasks.
+ * @param index The index of the task.
+ * @return false if the index is invalid or the timer is already running.
+ */
+bool startTimer(vector<Task>& tasks, int index) {
+    if (index < 1 || index > static_cast<int>(tasks.size())) {
+        cout << "Invalid task index." << endl;
+        return false;
+    }
+    Task& task = tasks[index - 1];
+    if (task.started != 0) {
+        cout << "The timer of task " << index << " is already running." << endl;
+        return false;
+    }
+    task.started = time(nullptr);
+    cout << "Started task " << index << ": " << task.description << endl;
+    return true;
+}
+
+/**
+ * @brief Stops the timer of a task.
+ *
+ * The interval is appended to the interval log, added to the task's running
+ * total and split by day into the per-tag aggregates.
+ * @param tasks The vector of tasks.
+ * @param index The index of the task.
+ * @return false if the index is invalid or the timer is not running.
+ */
+bool stopTimer(vector<Task>& tasks, int index) {
+    if (index < 1 || index > static_cast<int>(tasks.size())) {
+        cout << "Invalid task index." << endl;
+        return false;
+    }
+    Task& task = tasks[index - 1];
+    if (task.started == 0) {
+        cout << "The timer of task " << index << " is not running." << endl;
+        return false;
+    }
+    time_t start = task.started;
+    time_t end = max(start, time(nullptr));
+    pendingTimeLog += to_string(task.id) + " " + to_string(static_cast<long long>(start)) + " " + to_string(static_cast<long long>(end)) + "\n";
+
+    task.spent += end - start;
+    task.started = 0;
+
+    vector<string> tags = taskTags(task);
+    tags.push_back(TIME_TOTAL);
+    loadTimeSums();
+    for (time_t from = start; from < end;) {
+        tm local = *localtime(&from);
+        local.tm_hour = local.tm_min = local.tm_sec = 0;
+        ++local.tm_mday;
+        local.tm_isdst = -1;
+        time_t midnight = mktime(&local);
+        time_t until = min(end, midnight > from ? midnight : end);
+        for (const string& tag : tags) {
+            addTimeSum(timeSums[tag], localDate(from), until - from);
+        }
+        from = until;
+    }
+    timeSumsChanged = true;
+    cout << "Stopped task " << index << " after " << formatDuration(end - start) << " (total "
+         << formatDuration(task.spent) << ")." << endl;
+    return true;
+}
+
+/**
+ * @brief Prints tracked time.
+ *
+ * Without a range, prints the total of every task with tracked time followed
+ * by the per-tag totals of the current month. Per-tag totals are read from the
+ * aggregates, never from the interval log.
+ * @param tasks The vector of tasks.
+ * @param from The first day of the range, or empty for the current month.
+ * @param to The last day of the range, or empty for the current month.
+ */
+void reportTime(const vector<Task>& tasks, string from, string to) {
+    if (from.empty()) {
+        for (size_t i = 0; i < tasks.size(); ++i) {
+            const Task& task = tasks[i];
+            if (task.spent > 0 || task.started != 0) {
+                if (outputFormat == OutputFormat::Text) {
+                    cout << formatDuration(task.spent + (task.started ? time(nullptr) - task.started : 0)) << "  "
+                         << formatTask(task, i + 1) << endl;
+                } else {
+                    printTask(task, i + 1);
+                }
+            }
+        }
+        from = today().substr(0, 8) + "01";
+        to = dateFromDays(dayNumber(occurrence(from, 1, 'm', 1)) - 1);
+    }
+    loadTimeSums();
+    if (outputFormat != OutputFormat::Text) {
+        for (const auto& sums : timeSums) {
+            long long seconds = timeBetween(sums.first, from, to);
+            if (seconds > 0 && sums.first != TIME_TOTAL) JsonRecord().field("tag", sums.first).field("from", from).field("to", to).field("seconds", seconds);
+        }
+        JsonRecord().field("from", from).field("to", to).field("seconds", timeBetween(TIME_TOTAL, from, to));
+        return;
+    }
+    cout << "Time per tag from " << from << " to " << to << ":" << endl;
+    for (const auto& sums : timeSums) {
+        long long seconds = timeBetween(sums.first, from, to);
+        if (seconds > 0 && sums.first != TIME_TOTAL) cout << "  +" << sums.first << ": " << formatDuration(seconds) << endl;
+    }
+    cout << "  Total: " << formatDuration(timeBetween(TIME_TOTAL, from, to)) << endl;
+}
+
+std::string HASH_FILENAME = getExecutableDirectory() + "\\todo.hash"; /**< File path of the description hash index */
+
+const uint32_t HASH_MAGIC = 0x31485854;  /**< Identifies a hash index file ("TXH1"). */
+const unsigned BLOOM_PROBES = 6;         /**< The number of Bloom filter bits set per description. */
+
+/**
+ * @brief Hashes bytes with xxHash64.
+ * @param data The bytes to hash.
+ * @param size The number of bytes.
+ * @param seed The hash seed.
+ * @return The 64-bit hash.
+ */
+uint64_t xxHash64(const char* data, size_t size, uint64_t seed = 0) {
+    const uint64_t p1 = 11400714785074694791ULL, p2 = 14029467366897019727ULL, p3 = 1609587929392839161ULL;
+    const uint64_t p4 = 9650029242287828579ULL, p5 = 2870177450012600261ULL;
+    auto rotl = [](uint64_t x, int r) { return (x << r) | (x >> (64 - r)); };
+    auto round = [&](uint64_t acc, uint64_t input) { return rotl(acc + input * p2, 31) * p1; };
+    auto read64 = [](const char* p) { uint64_t v; memcpy(&v, p, 8); return v; };
+    auto read32 = [](const char* p) { uint32_t v; memcpy(&v, p, 4); return static_cast<uint64_t>(v); };
+    const char* p = data;
+    const char* end = data + size;
+    uint64_t h;
+    if (size >= 32) {
+        uint64_t v1 = seed + p1 + p2, v2 = seed + p2, v3 = seed, v4 = seed - p1;
+        for (; p + 32 <= end; p += 32) {
+            v1 = round(v1, read64(p));
+            v2 = round(v2, read64(p + 8));
+            v3 = round(v3, read64(p + 16));
+            v4 = round(v4, read64(p + 24));
+        }
+        h = rotl(v1, 1) + rotl(v2, 7) + rotl(v3, 12) + rotl(v4, 18);
+        for (uint64_t v : {v1, v2, v3, v4}) h = (h ^ round(0, v)) * p1 + p4;
+    } else {
+        h = seed + p5;
+    }
+    h += size;
+    for (; p + 8 <= end; p += 8) h = rotl(h ^ round(0, read64(p)), 27) * p1 + p4;
+    if (p + 4 <= end) {
+        h = rotl(h ^ (read32(p) * p1), 23) * p2 + p3;
+        p += 4;
+    }
+    for (; p < end; ++p) h = rotl(h ^ (static_cast<unsigned char>(*p) * p5), 11) * p1;
+    h ^= h >> 33;
+    h *= p2;
+    h ^= h >> 29;
+    h *= p3;
+    h ^= h >> 32;
+    return h;
+}
+
+/**
+ * @brief Normalizes a description for duplicate detection.
+ * @param description The description.
+ * @return The description in lower case, with runs of whitespace collapsed to one space.
+ */
+string normalizeDescription(const string& description) {
+    string normalized;
+    normalized.reserve(description.size());
+    for (char c : description) {
+        if (isspace(static_cast<unsigned char>(c))) {
+            if (!normalized.empty() && normalized.back() != ' ') normalized += ' ';
+        } else {
+            normalized += static_cast<char>(tolower(static_cast<unsigned char>(c)));
+        }
+    }
+    if (!normalized.empty() && normalized.back() == ' ') normalized.pop_back();
+    return normalized;
+}
+
+/**
+ * @brief Hashes a description after normalizing it.
+ * @param description The description.
+ * @return The hash; never 0, which marks an empty slot.
+ */
+uint64_t descriptionHash(const string& description) {
+    string normalized = normalizeDescription(description);
+    uint64_t hash = xxHash64(normalized.data(), normalized.size());
+    return hash == 0 ? 1 : hash;
+}
+
+/**
+ * @struct HashIndex
+ * @brief The open tasks keyed by the hash of their normalized description.
+ *
+ * An open-addressing table of (hash, task ID) slots with linear probing, and a
+ * Bloom filter in front of it. Both are stored in one file with fixed-size
+ * sections, so a lookup can read the few Bloom filter words and table slots it
+ * needs without reading the rest of the file or the task list.
+ */
+struct HashIndex {
+    bool loaded = false;                        /**< Whether the index file has been read. */
+    bool valid = false;                         /**< Whether the index matches the current task file. */
+    bool changed = false;                       /**< Whether the index has changed since it was loaded. */
+    size_t count = 0;                           /**< The number of occupied slots. */
+    vector<uint64_t> bloom;                     /**< The Bloom filter bits; the size is a power of two. */
+    vector<pair<uint64_t, unsigned>> slots;     /**< (hash, task ID) slots; the size is a power of two. */
+};
+
+HashIndex hashIndex; /**< The hash index, loaded on first use by loadHashIndex(). */
+
+/**
+ * @brief Computes the Bloom filter bit positions of a hash.
+ * @param hash The description hash.
+ * @param bits The size of the filter in bits, a power of two.
+ * @param probe The probe number, from 0 to BLOOM_PROBES - 1.
+ * @return The bit position.
+ */
+uint64_t bloomBit(uint64_t hash, uint64_t bits, unsigned probe) {
+    uint64_t h1 = hash & 0xFFFFFFFF;
+    uint64_t h2 = (hash >> 32) | 1;
+    return (h1 + probe * h2) & (bits - 1);
+}
+
+/**
+ * @brief Adds a slot to the index, growing the table and filter if needed.
+ * @param hash The description hash.
+ * @param id The task ID.
+ */
+void insertHash(uint64_t hash, unsigned id) {
+    if ((hashIndex.count + 1) * 2 > hashIndex.slots.size()) {
+        vector<pair<uint64_t, unsigned>> old = move(hashIndex.slots);
+        size_t capacity = max<size_t>(64, old.size() * 2);
+        hashIndex.slots.assign(capacity, {0, 0});
+        hashIndex.bloom.assign(capacity / 4, 0);  // 16 bits per slot
+        hashIndex.count = 0;
+        for (const auto& slot : old) {
+            if (slot.first != 0) insertHash(slot.first, slot.second);
+        }
+    }
+    size_t mask = hashIndex.slots.size() - 1;
+    size_t i = hash & mask;
+    while (hashIndex.slots[i].first != 0) i = (i + 1) & mask;
+    hashIndex.slots[i] = {hash, id};
+    ++hashIndex.count;
+    uint64_t bits = hashIndex.bloom.size() * 64;
+    for (unsigned probe = 0; probe < BLOOM_PROBES; ++probe) {
+        uint64_t bit = bloomBit(hash, bits, probe);
+        hashIndex.bloom[bit / 64] |= 1ULL << (bit % 64);
+    }
+}
+
+/**
+ * @brief Removes a slot from the index.
+ *
+ * Later slots of the probe sequence are shifted back, so lookups never need
+ * tombstones. The Bloom filter keeps the bits until the table is next resized.
+ * @param hash The description hash.
+ * @param id The task ID.
+ */
+void eraseHash(uint64_t hash, unsigned id) {
+    if (hashIndex.slots.empty()) return;
+    size_t mask = hashIndex.slots.size() - 1;
+    size_t i = hash & mask;
+    while (hashIndex.slots[i].first != 0 && hashIndex.slots[i] != make_pair(hash, id)) i = (i + 1) & mask;
+    if (hashIndex.slots[i].first == 0) return;
+    for (size_t j = (i + 1) & mask; hashIndex.slots[j].first != 0; j = (j + 1) & mask) {
+        size_t home = hashIndex.slots[j].first & mask;
+        // Move slot j into the hole unless its home lies cyclically in (i, j]
+        if (((j - home) & mask) >= ((j - i) & mask)) {
+            hashIndex.slots[i] = hashIndex.slots[j];
+            i = j;
+        }
+    }
+    hashIndex.slots[i] = {0, 0};
+    --hashIndex.count;
+}
+
+/**
+ * @brief Looks up the open task with a description.
+ * @param description The description.
+ * @return The ID of the first open task with the same normalized description, or 0.
+ */
+unsigned findHash(const string& description) {
+    if (hashIndex.slots.empty()) return 0;
+    uint64_t hash = descriptionHash(description);
+    uint64_t bits = hashIndex.bloom.size() * 64;
+    for (unsigned probe = 0; probe < BLOOM_PROBES; ++probe) {
+        uint64_t bit = bloomBit(hash, bits, probe);
+        if (!(hashIndex.bloom[bit / 64] >> (bit % 64) & 1)) return 0;
+    }
+    size_t mask = hashIndex.slots.size() - 1;
+    for (size_t i = hash & mask; hashIndex.slots[i].first != 0; i = (i + 1) & mask) {
+        if (hashIndex.slots[i].first == hash) return hashIndex.slots[i].second;
+    }
+    return 0;
+}
+
+/**
+ * @brief Reads a section of the hash index file.
+ * @param file The open index file.
+ * @param offset The byte offset of the section.
+ * @param data Receives the bytes.
+ * @param size The number of bytes.
+ * @return false if the file is too short.
+ */
+bool readAt(FILE* file, long long offset, void* data, size_t size) {
+    return fseek(file, static_cast<long>(offset), SEEK_SET) == 0 && fread(data, 1, size, file) == size;
+}
+
+/**
+ * @brief Reads the header of the hash index file.
+ *
+ * The header holds the magic number, the task file stamp and the sizes of the
+ * Bloom filter, in 64-bit words, and of the table, in slots.
+ * @param file The open index file.
+ * @param words Receives the number of Bloom filter words.
+ * @param slots Receives the number of table slots.
+ * @param count Receives the number of occupied slots.
+ * @return The offset of the Bloom filter, or 0 if the index does not match the task file.
+ */
+long long readHashHeader(FILE* file, uint64_t& words, uint64_t& slots, uint64_t& count) {
+    uint32_t header[2];
+    if (!readAt(file, 0, header, sizeof(header)) || header[0] != HASH_MAGIC || header[1] > 64) return 0;
+    string stamp(header[1], '\0');
+    uint64_t sizes[3];
+    if (fread(&stamp[0], 1, stamp.size(), file) != stamp.size() || fread(sizes, 1, sizeof(sizes), file) != sizeof(sizes)) return 0;
+    if (stamp != taskFileStamp()) return 0;
+    words = sizes[0];
+    slots = sizes[1];
+    count = sizes[2];
+    return static_cast<long long>(sizeof(header) + stamp.size() + sizeof(sizes));
+}
+
+/**
+ * @brief Checks the hash index file for an open task with a description.
+ *
+ * Reads only the header, the Bloom filter words of the description and the
+ * table slots on its probe sequence, so the cost does not depend on the number
+ * of tasks.
+ * @param description The description.
+ * @return 1 if such a task exists, 0 if not, or -1 if the index is missing or out of date.
+ */
+int probeHashFile(const string& description) {
+    FILE* file = fopen(HASH_FILENAME.c_str(), "rb");
+    if (!file) return -1;
+    uint64_t words = 0, slots = 0, count = 0;
+    long long bloomOffset = readHashHeader(file, words, slots, count);
+    int found = bloomOffset == 0 ? -1 : 0;
+    uint64_t hash = descriptionHash(description);
+    bool maybe = found == 0 && words > 0 && slots > 0;
+    for (unsigned probe = 0; maybe && probe < BLOOM_PROBES; ++probe) {
+        uint64_t bit = bloomBit(hash, words * 64, probe);
+        uint64_t word = 0;
+        if (!readAt(file, bloomOffset + static_cast<long long>(bit / 64 * 8), &word, 8)) found = -1;
+        maybe = found == 0 && (word >> (bit % 64) & 1);
+    }
+    long long slotOffset = bloomOffset + static_cast<long long>(words * 8);
+    for (uint64_t i = hash & (slots - 1); maybe; i = (i + 1) & (slots - 1)) {
+        uint64_t slot[2];
+        if (!readAt(file, slotOffset + static_cast<long long>(i * 16), slot, sizeof(slot))) found = -1;
+        if (found != 0 || slot[0] == 0) break;
+        if (slot[0] == hash) found = 1;
+        maybe = found == 0;
+    }
+    fclose(file);
+    return found;
+}
+
+/**
+ * @brief Loads the hash index unless it is already loaded.
+ *
+ * The index is only trusted if the task file has not changed since it was written.
+ */
+void loadHashIndex() {
+    if (hashIndex.loaded) return;
+    hashIndex.loaded = true;
+    FILE* file = fopen(HASH_FILENAME.c_str(), "rb");
+    if (!file) return;
+    uint64_t words = 0, slots = 0, count = 0;
+    if (readHashHeader(file, words, slots, count) != 0 && (slots & (slots - 1)) == 0) {
+        hashIndex.bloom.resize(words);
+        vector<uint64_t> raw(slots * 2);
+        if (fread(hashIndex.bloom.data(), 8, words, file) == words && fread(raw.data(), 8, raw.size(), file) == raw.size()) {
+            hashIndex.slots.resize(slots);
+            for (size_t i = 0; i < slots; ++i) hashIndex.slots[i] = {raw[2 * i], static_cast<unsigned>(raw[2 * i + 1])};
+            hashIndex.count = count;
+            hashIndex.valid = true;
+        }
+    }
+    fclose(file);
+    if (!hashIndex.valid) {
+        hashIndex.bloom.clear();
+        hashIndex.slots.clear();
+        hashIndex.count = 0;
+    }
+}
+
+/**
+ * @brief Writes the hash index to the index file.
+ */
+void saveHashIndex() {
+    FILE* file = fopen(HASH_FILENAME.c_str(), "wb");
+    if (!file) return;
+    string stamp = taskFileStamp();
+    uint32_t header[2] = {HASH_MAGIC, static_cast<uint32_t>(stamp.size())};
+    uint64_t sizes[3] = {hashIndex.bloom.size(), hashIndex.slots.size(), hashIndex.count};
+    fwrite(header, 1, sizeof(header), file);
+    fwrite(stamp.data(), 1, stamp.size(), file);
+    fwrite(sizes, 1, sizeof(sizes), file);
+    fwrite(hashIndex.bloom.data(), 8, hashIndex.bloom.size(), file);
+    for (const auto& slot : hashIndex.slots) {
+        uint64_t raw[2] = {slot.first, slot.second};
+        fwrite(raw, 1, sizeof(raw), file);
+    }
+    fclose(file);
+    hashIndex.changed = false;
+}
+
+/**
+ * @brief Rebuilds the hash index from a task list.
+ *
+ * Only needed when the task file was changed outside this program.
+ * @param tasks The vector of tasks.
+ */
+void rebuildHashIndex(const vector<Task>& tasks) {
+    hashIndex.bloom.clear();
+    hashIndex.slots.clear();
+    hashIndex.count = 0;
+    for (const Task& task : tasks) {
+        if (!task.completed) insertHash(descriptionHash(task.description), task.id);
+    }
+    hashIndex.valid = true;
+    hashIndex.changed = true;
+}
+
+/**
+ * @brief Adjusts the hash index for one task change.
+ *
+ * Only open tasks are indexed, so completing a task makes its description
+ * available again.
+ * @param change The kind of change.
+ * @param task The task after the change (before it, for removals).
+ */
+void updateHashIndex(Change change, const Task& task) {
+    loadHashIndex();
+    if (!hashIndex.valid) return;  // rebuilt by saveTasks()
+    if (change == Change::Added && !task.completed) {
+        insertHash(descriptionHash(task.description), task.id);
+        hashIndex.changed = true;
+    } else if (change == Change::Completed || change == Change::Removed) {
+        eraseHash(descriptionHash(task.description), task.id);
+        hashIndex.changed = true;
+    }
+}
+
+/**
+ * @brief Finds the open task with a description.
+ * @param tasks The vector of tasks.
+ * @param description The description, compared after normalization.
+ * @return The 1-based index of the task, or 0 if there is none.
+ */
+int findExactTask(const vector<Task>& tasks, const string& description) {
+    loadHashIndex();
+    if (!hashIndex.valid) {
+        rebuildHashIndex(tasks);
+        saveHashIndex();  // the task file is unchanged so far, so later lookups can use the file
+    }
+    unsigned id = findHash(description);
+    if (id == 0) return 0;
+    auto positions = positionsById(tasks);
+    auto it = positions.find(id);
+    if (it == positions.end() || normalizeDescription(tasks[it->second].description) != normalizeDescription(description)) return 0;
+    return static_cast<int>(it->second) + 1;
+}
+
+const size_t MINHASH_BANDS = 8;  /**< The number of LSH bands of a MinHash signature. */
+const size_t MINHASH_ROWS = 4;   /**< The number of MinHash values per band. */
+
+/**
+ * @brief Collects the hashed character trigrams of a normalized description.
+ * @param normalized The normalized description.
+ * @return The distinct trigram hashes, sorted.
+ */
+vector<uint64_t> shingles(const string& normalized) {
+    vector<uint64_t> result;
+    if (normalized.size() < 3) {
+        result.push_back(xxHash64(normalized.data(), normalized.size()));
+        return result;
+    }
+    for (size_t i = 0; i + 3 <= normalized.size(); ++i) {
+        result.push_back(xxHash64(normalized.data() + i, 3));
+    }
+    sort(result.begin(), result.end());
+    result.erase(unique(result.begin(), result.end()), result.end());
+    return result;
+}
+
+/**
+ * @brief Computes the Jaccard similarity of two sorted shingle sets.
+ * @param a The first set.
+ * @param b The second set.
+ * @return The size of the intersection divided by the size of the union.
+ */
+double jaccard(const vector<uint64_t>& a, const vector<uint64_t>& b) {
+    size_t common = 0;
+    for (size_t i = 0, j = 0; i < a.size() && j < b.size();) {
+        if (a[i] == b[j]) {
+            ++common;
+            ++i;
+            ++j;
+        } else if (a[i] < b[j]) {
+            ++i;
+        } else {
+            ++j;
+        }
+    }
+    return static_cast<double>(common) / static_cast<double>(a.size() + b.size() - common);
+}
+
+/**
+ * @brief Finds the representative of a set in a union-find forest.
+ * @param parent The parent of every element.
+ * @param i The element.
+ * @return The representative of the set containing i.
+ */
+size_t findSet(vector<size_t>& parent, size_t i) {
+    while (parent[i] != i) {
+        parent[i] = parent[parent[i]];  // path halving
+        i = parent[i];
+    }
+    return i;
+}
+
+/**
+ * @brief Merges duplicate tasks.
+ *
+ * Exact duplicates are found by hashing the normalized descriptions. Near duplicates are found with MinHash signatures over character
+ * trigrams: tasks that agree on all values of at least one LSH band are
+ * candidates and are merged if the Jaccard similarity of their trigrams reaches
+ * the threshold. Each task is compared with a few earlier tasks per band only,
+ * so the run time grows about linearly with the list.
+ *
+ * Only siblings (tasks with the same parent) are merged. In each group the
+ * earliest task is kept; it is marked done if any of its duplicates was done,
+ * and their tracked time is added to it. Tasks with subtasks, dependencies,
+ * recurrence or a running timer are never removed.
+ * @param tasks The vector of tasks.
+ * @param threshold The minimum trigram similarity of near duplicates, from 0 to 1.
+ * @param dryRun If true, the duplicates are only listed.
+ * @return The number of tasks removed (or that would be removed).
+ */
+size_t dedupeTasks(vector<Task>& tasks, double threshold, bool dryRun) {
+    size_t n = tasks.size();
+    vector<size_t> parent(n);
+    for (size_t i = 0; i < n; ++i) parent[i] = i;
+    auto unite = [&](size_t a, size_t b) {
+        a = findSet(parent, a);
+        b = findSet(parent, b);
+        if (a != b) parent[max(a, b)] = min(a, b);
+    };
+
+    // Exact duplicates
+    unordered_map<uint64_t, size_t> first;
+    vector<string> normalized(n);
+    for (size_t i = 0; i < n; ++i) {
+        normalized[i] = normalizeDescription(tasks[i].description);
+        uint64_t key = xxHash64(normalized[i].data(), normalized[i].size(), tasks[i].parent);
+        auto inserted = first.insert({key, i});
+        if (!inserted.second && normalized[inserted.first->second] == normalized[i]) unite(inserted.first->second, i);
+    }
+    first.clear();
+
+    // Near duplicates
+    const size_t hashes = MINHASH_BANDS * MINHASH_ROWS;
+    const size_t compared = 4;  // earlier tasks in the same bucket each task is compared with
+    uint64_t multipliers[hashes];
+    uint64_t increments[hashes];
+    uint64_t state = 0x9E3779B97F4A7C15ULL;
+    for (size_t k = 0; k < hashes; ++k) {
+        state = xxHash64(reinterpret_cast<const char*>(&state), sizeof(state));
+        multipliers[k] = state | 1;
+        state = xxHash64(reinterpret_cast<const char*>(&state), sizeof(state));
+        increments[k] = state;
+    }
+    vector<uint64_t> bandKeys(n * MINHASH_BANDS);
+    for (size_t i = 0; i < n; ++i) {
+        vector<uint64_t> set = shingles(normalized[i]);
+        uint64_t signature[hashes];
+        for (size_t k = 0; k < hashes; ++k) signature[k] = UINT64_MAX;
+        for (uint64_t shingle : set) {
+            for (size_t k = 0; k < hashes; ++k) {
+                signature[k] = min(signature[k], shingle * multipliers[k] + increments[k]);
+            }
+        }
+        for (size_t band = 0; band < MINHASH_BANDS; ++band) {
+            bandKeys[i * MINHASH_BANDS + band] = xxHash64(reinterpret_cast<const char*>(signature + band * MINHASH_ROWS),
+                                                          MINHASH_ROWS * sizeof(uint64_t), tasks[i].parent);
+        }
+    }
+    vector<pair<uint64_t, size_t>> bucket(n);
+    for (size_t band = 0; band < MINHASH_BANDS; ++band) {
+        for (size_t i = 0; i < n; ++i) bucket[i] = {bandKeys[i * MINHASH_BANDS + band], i};
+        sort(bucket.begin(), bucket.end());
+        for (size_t start = 0, end; start < n; start = end) {
+            for (end = start + 1; end < n && bucket[end].first == bucket[start].first; ++end) {
+                size_t i = bucket[end].second;
+                vector<uint64_t> set;
+                for (size_t c = end - min(end - start, compared); c < end; ++c) {
+                    size_t j = bucket[c].second;
+                    if (tasks[j].parent != tasks[i].parent || findSet(parent, i) == findSet(parent, j)) continue;
+                    if (set.empty()) set = shingles(normalized[i]);
+                    if (jaccard(set, shingles(normalized[j])) >= threshold) unite(i, j);
+                }
+            }
+        }
+    }
+    bandKeys.clear();
+    bucket.clear();
+
+    // Keep the earliest task of every group
+    vector<size_t> kept(n, SIZE_MAX);
+    auto earlier = [&](size_t a, size_t b) {
+        return tie(tasks[a].created, tasks[a].id) < tie(tasks[b].created, tasks[b].id);
+    };
+    for (size_t i = 0; i < n; ++i) {
+        size_t root = findSet(parent, i);
+        if (kept[root] == SIZE_MAX || earlier(i, kept[root])) kept[root] = i;
+    }
+    vector<bool> removed(n, false);
+    unordered_map<unsigned, size_t> positions;
+    size_t count = 0;
+    for (size_t i = 0; i < n; ++i) {
+        size_t keep = kept[findSet(parent, i)];
+        const Task& task = tasks[i];
+        bool hasChildren = i + 1 < n && tasks[i + 1].parent == task.id;
+        if (keep == i || hasChildren || !task.after.empty() || !task.blocks.empty() || !task.every.empty() || task.started != 0) continue;
+        if (!dryRun) {
+            Task& survivor = tasks[keep];
+            survivor.spent += task.spent;
+            if (task.completed && !survivor.completed && survivor.every.empty()) {
+                survivor.completed = true;
+                if (positions.empty() && !survivor.blocks.empty()) positions = positionsById(tasks);
+                for (unsigned id : survivor.blocks) {
+                    Task* dependent = taskById(tasks, positions, id);
+                    if (dependent && dependent->blockers > 0) --dependent->blockers;
+                }
+                recordChange(Change::Completed, survivor);
+            }
+            recordChange(Change::Removed, task);
+        }
+        cout << "Duplicate of " << keep + 1 << ": " << formatTask(task, i + 1) << endl;
+        removed[i] = true;
+        ++count;
+    }
+    if (!dryRun && count > 0) {
+        size_t out = 0;
+        for (size_t i = 0; i < n; ++i) {
+            if (removed[i]) continue;
+            if (out != i) tasks[out] = move(tasks[i]);
+            ++out;
+        }
+        tasks.erase(tasks.begin() + out, tasks.end());
+    }
+    return count;
+}
+
+/**
+ * @struct FuzzyMatch
+ * @brief A task that approximately matches a search text.
+ */
+struct FuzzyMatch {
+    size_t position;   /**< The 0-based position of the task in the list. */
+    int distance;      /**< The edit distance between the text and the best-matching part of the description. */
+};
+
+/**
+ * @brief Computes the edit distance of a pattern to its best match in a text.
+ *
+ * Uses Myers' bit-parallel algorithm: one column of the dynamic programming
+ * matrix is kept as bit vectors, so each text character costs a few word
+ * operations. The match may start and end anywhere in the text.
+ * @param peq For every byte, the bit mask of the pattern positions it matches.
+ * @param length The pattern length, at most 64.
+ * @param text The text.
+ * @param limit The largest distance of interest.
+ * @return The smallest distance, or limit + 1 if it exceeds the limit.
+ */
+int myersDistance(const uint64_t peq[256], size_t length, const string& text, int limit) {
+    uint64_t pv = length == 64 ? ~0ULL : (1ULL << length) - 1;
+    uint64_t mv = 0;
+    uint64_t high = 1ULL << (length - 1);
+    int score = static_cast<int>(length);
+    int best = score;
+    for (char c : text) {
+        uint64_t eq = peq[static_cast<unsigned char>(c)];
+        uint64_t xv = eq | mv;
+        uint64_t xh = (((eq & pv) + pv) ^ pv) | eq;
+        uint64_t ph = mv | ~(xh | pv);
+        uint64_t mh = pv & xh;
+        if (ph & high) ++score;
+        else if (mh & high) --score;
+        ph <<= 1;
+        mh <<= 1;
+        pv = mh | ~(xv | ph);
+        mv = ph & xv;
+        best = min(best, score);
+    }
+    return best <= limit ? best : limit + 1;
+}
+
+/**
+ * @brief Computes the edit distance of a pattern to its best match in a text.
+ *
+ * The plain dynamic programming version, used for patterns longer than 64 bytes.
+ * @param pattern The pattern, in lower case.
+ * @param text The text, in lower case.
+ * @param limit The largest distance of interest.
+ * @return The smallest distance, or limit + 1 if it exceeds the limit.
+ */
+int editDistance(const string& pattern, const string& text, int limit) {
+    vector<int> column(pattern.size() + 1);
+    for (size_t i = 0; i <= pattern.size(); ++i) column[i] = static_cast<int>(i);
+    int best = column.back();
+    for (char c : text) {
+        int diagonal = 0;  // the match may start anywhere in the text
+        for (size_t i = 1; i <= pattern.size(); ++i) {
+            int above = column[i];
+            column[i] = min({column[i] + 1, column[i - 1] + 1, diagonal + (pattern[i - 1] == c ? 0 : 1)});
+            diagonal = above;
+        }
+        best = min(best, column.back());
+    }
+    return best <= limit ? best : limit + 1;
+}
+
+const unsigned TRIGRAM_SLOT_BITS = 15;  /**< The trigram index has 2^15 posting lists. */
+
+/**
+ * @brief Returns the posting list of the trigram of a text at a position.
+ *
+ * Letters are folded to lower case and get codes of their own, as does the
+ * space; digits share one code and other bytes the remaining four. Trigrams
+ * of the same list only add candidates, which the trigram filter then rejects.
+ * The lists are few enough for their ends to stay in the cache while the index
+ * is built.
+ * @param text The text.
+ * @param i The position of the first of the three bytes.
+ * @return The list number, below 2^TRIGRAM_SLOT_BITS.
+ */
+uint32_t trigramSlot(const string& text, size_t i) {
+    static const vector<uint8_t> codes = [] {
+        vector<uint8_t> table(256);
+        for (int c = 0; c < 256; ++c) {
+            table[c] = static_cast<uint8_t>(isalpha(c) ? tolower(c) - 'a' : c == ' ' ? 26 : isdigit(c) ? 27 : 28 + c % 4);
+        }
+        return table;
+    }();
+    auto code = [&](size_t j) { return static_cast<uint32_t>(codes[static_cast<unsigned char>(text[j])]); };
+    return code(i) << 10 | code(i + 1) << 5 | code(i + 2);
+}
+
+/**
+ * @struct TrigramIndex
+ * @brief Posting lists from description trigrams to task IDs.
+ *
+ * Kept in memory while `todo shell` runs: built on the first fuzzy lookup and
+ * then kept up to date by recordChange(). A removed task stays in the lists
+ * until the index is rebuilt, and is skipped because its ID has no position.
+ */
+struct TrigramIndex {
+    bool valid = false;                                  /**< Whether the index matches the loaded list. */
+    vector<vector<unsigned>> postings;                   /**< The IDs of the tasks containing a trigram of each list, see trigramSlot(). */
+    vector<size_t> positions;                            /**< The last known 0-based position of every ID, or npos. */
+    size_t live = 0;                                     /**< The number of indexed tasks that still exist. */
+    size_t removed = 0;                                  /**< The number of removed tasks still in the lists. */
+};
+
+TrigramIndex trigramIndex; /**< The trigram index of `todo shell`, built by buildTrigramIndex(). */
+
+/**
+ * @brief Adds a task to the trigram index.
+ * @param task The task.
+ */
+void indexTrigrams(const Task& task) {
+    const string& description = task.description;
+    for (size_t i = 0; i + 3 <= description.size(); ++i) {
+        vector<unsigned>& list = trigramIndex.postings[trigramSlot(description, i)];
+        if (list.empty() || list.back() != task.id) list.push_back(task.id);  // once per task
+    }
+    ++trigramIndex.live;
+}
+
+/**
+ * @brief Records the current position of every task in the trigram index.
+ *
+ * Positions are kept in a vector indexed by ID, which is rebuilt with one pass
+ * over the list whenever tasks have moved.
+ * @param tasks The vector of tasks.
+ */
+void locateTrigramTasks(const vector<Task>& tasks) {
+    unsigned highest = 0;
+    for (const Task& task : tasks) highest = max(highest, task.id);
+    trigramIndex.positions.assign(static_cast<size_t>(highest) + 1, string::npos);
+    for (size_t i = 0; i < tasks.size(); ++i) trigramIndex.positions[tasks[i].id] = i;
+}
+
+/**
+ * @brief Builds the trigram index of a task list.
+ * @param tasks The vector of tasks.
+ */
+void buildTrigramIndex(const vector<Task>& tasks) {
+    trigramIndex = TrigramIndex();
+    trigramIndex.postings.resize(size_t(1) << TRIGRAM_SLOT_BITS);
+    for (const Task& task : tasks) indexTrigrams(task);
+    locateTrigramTasks(tasks);
+    trigramIndex.valid = true;
+}
+
+/**
+ * @brief Keeps the trigram index up to date with a task change.
+ *
+ * Descriptions never change, so only additions and removals matter. The index
+ * is dropped, to be rebuilt by the next lookup, once removed tasks outnumber
+ * the others.
+ * @param change The kind of change.
+ * @param task The task after the change (before it, for removals).
+ */
+void updateTrigramIndex(Change change, const Task& task) {
+    if (!trigramIndex.valid) return;
+    if (change == Change::Added) {
+        indexTrigrams(task);
+    } else if (change == Change::Removed) {
+        if (task.id < trigramIndex.positions.size()) trigramIndex.positions[task.id] = string::npos;
+        --trigramIndex.live;
+        if (++trigramIndex.removed > trigramIndex.live) trigramIndex = TrigramIndex();
+    }
+}
+
+/**
+ * @brief Finds the tasks whose description approximately contains a text.
+ *
+ * Up to a quarter of the text's characters may be wrong, missing or extra.
+ * Candidates are first filtered by trigrams: a match with k errors still
+ * shares all but 3k of the text's trigrams, so descriptions sharing fewer are
+ * skipped without computing a distance. In `todo shell` the candidates come
+ * from the trigram index: a description sharing enough trigrams is in at
+ * least one of the posting lists of the text's trigrams but the 3k longest
+ * (lists shared by several of them count once), so only those lists are read
+ * rather than the whole list. A single command
+ * scans the descriptions instead, since building the index would cost more
+ * than the scan. Matches are ranked by distance, then by how close the
+ * description length is to the text length.
+ * @param tasks The vector of tasks.
+ * @param text The search text.
+ * @param openOnly If true, completed tasks are ignored.
+ * @param limit The maximum number of matches.
+ * @return The best matches, best first.
+ */
+vector<FuzzyMatch> fuzzyFind(const vector<Task>& tasks, const string& text, bool openOnly, size_t limit) {
+    string pattern = normalizeDescription(text);
+    vector<FuzzyMatch> matches;
+    if (pattern.empty()) return matches;
+    int maxDistance = static_cast<int>(pattern.size() / 4);
+
+    // Upper-case letters match too, so descriptions are searched without copying them
+    uint64_t peq[256] = {};
+    unsigned char lower[256];
+    for (int c = 0; c < 256; ++c) lower[c] = static_cast<unsigned char>(tolower(c));
+    for (size_t i = 0; i < pattern.size() && i < 64; ++i) {
+        unsigned char c = static_cast<unsigned char>(pattern[i]);
+        peq[c] |= 1ULL << i;
+        peq[static_cast<unsigned char>(toupper(c))] |= 1ULL << i;
+    }
+    auto trigram = [&](const string& s, size_t i) {
+        return static_cast<uint32_t>(lower[static_cast<unsigned char>(s[i])]) << 16 |
+               static_cast<uint32_t>(lower[static_cast<unsigned char>(s[i + 1])]) << 8 | lower[static_cast<unsigned char>(s[i + 2])];
+    };
+    vector<uint32_t> grams;
+    for (size_t i = 0; i + 3 <= pattern.size(); ++i) grams.push_back(trigram(pattern, i));
+    sort(grams.begin(), grams.end());
+    grams.erase(unique(grams.begin(), grams.end()), grams.end());
+    uint64_t filter[64] = {};  // 4096-bit filter over the pattern trigrams
+    for (uint32_t gram : grams) filter[(gram * 2654435761u >> 20) / 64] |= 1ULL << ((gram * 2654435761u >> 20) % 64);
+    long long required = static_cast<long long>(grams.size()) - 3LL * maxDistance;
+
+    vector<bool> seen(grams.size());
+    auto consider = [&](size_t p) {
+        if (openOnly && tasks[p].completed) return;
+        const string& description = tasks[p].description;
+        if (required > 0) {
+            long long shared = 0;
+            fill(seen.begin(), seen.end(), false);
+            for (size_t i = 0; i + 3 <= description.size() && shared < required; ++i) {
+                uint32_t gram = trigram(description, i);
+                uint32_t bit = gram * 2654435761u >> 20;
+                if (!(filter[bit / 64] >> (bit % 64) & 1)) continue;
+                auto it = lower_bound(grams.begin(), grams.end(), gram);
+                if (it != grams.end() && *it == gram && !seen[it - grams.begin()]) {
+                    seen[it - grams.begin()] = true;
+                    ++shared;
+                }
+            }
+            if (shared < required) return;
+        }
+        int distance = pattern.size() <= 64 ? myersDistance(peq, pattern.size(), description, maxDistance)
+                                            : editDistance(pattern, toLower(description), maxDistance);
+        if (distance <= maxDistance) matches.push_back({p, distance});
+    };
+    bool indexed = required > 0 && residentSession;
+    vector<const vector<unsigned>*> lists;
+    if (indexed) {
+        if (!trigramIndex.valid) buildTrigramIndex(tasks);
+        vector<uint32_t> slots;
+        for (size_t i = 0; i + 3 <= pattern.size(); ++i) slots.push_back(trigramSlot(pattern, i));
+        sort(slots.begin(), slots.end());
+        slots.erase(unique(slots.begin(), slots.end()), slots.end());
+        for (uint32_t slot : slots) lists.push_back(&trigramIndex.postings[slot]);
+        sort(lists.begin(), lists.end(), [](const vector<unsigned>* a, const vector<unsigned>* b) { return a->size() < b->size(); });
+        lists.resize(min(lists.size(), grams.size() - static_cast<size_t>(required) + 1));
+        size_t postings = 0;
+        for (const vector<unsigned>* list : lists) postings += list->size();
+        indexed = postings <= tasks.size() / 8;  // otherwise the trigrams are too common to narrow the search
+    }
+    if (indexed) {
+        vector<unsigned> ids;
+        for (const vector<unsigned>* list : lists) ids.insert(ids.end(), list->begin(), list->end());
+        sort(ids.begin(), ids.end());
+        ids.erase(unique(ids.begin(), ids.end()), ids.end());
+        bool refreshed = false;  // positions are refreshed once if tasks have moved
+        const vector<size_t>& positions = trigramIndex.positions;
+        for (unsigned id : ids) {
+            size_t p = id < positions.size() ? positions[id] : string::npos;
+            if ((p >= tasks.size() || tasks[p].id != id) && !refreshed) {
+                locateTrigramTasks(tasks);
+                refreshed = true;
+                p = id < positions.size() ? positions[id] : string::npos;
+            }
+            if (p < tasks.size() && tasks[p].id == id) consider(p);  // otherwise removed
+        }
+    } else {
+        for (size_t p = 0; p < tasks.size(); ++p) consider(p);
+    }
+    auto better = [&](const FuzzyMatch& a, const FuzzyMatch& b) {
+        long long extraA = llabs(static_cast<long long>(tasks[a.position].description.size()) - static_cast<long long>(pattern.size()));
+        long long extraB = llabs(static_cast<long long>(tasks[b.position].description.size()) - static_cast<long long>(pattern.size()));
+        return tie(a.distance, extraA, a.position) < tie(b.distance, extraB, b.position);
+    };
+    if (matches.size() > limit) {
+        partial_sort(matches.begin(), matches.begin() + limit, matches.end(), better);
+        matches.resize(limit);
+    } else {
+        sort(matches.begin(), matches.end(), better);
+    }
+    return matches;
+}
+
+/**
+ * @brief Parses a task number given on the command line.
+ * @param text The argument.
+ * @param number Receives the number.
+ * @return false if the argument is not a number.
+ */
+bool parseTaskNumber(const string& text, int& number) {
+    if (text.empty() || text.size() > 9 || text.find_first_not_of("0123456789") != string::npos) return false;
+    number = atoi(text.c_str());
+    return true;
+}
+
+/**
+ * @brief Resolves a task reference given as an index or as a description.
+ *
+ * A number is taken as a list index and `#N` as the task with ID N. Any other text is matched approximately
+ * against the descriptions; the best match is used if it is closer than the
+ * next one or equal to the text, otherwise the closest matches are listed.
+ * Destructive commands pass exact, so only a description equal to the text
+ * resolves; close matches are listed but not used.
+ * @param tasks The vector of tasks.
+ * @param reference The index or the description text.
+ * @param openOnly If true, only open tasks are matched by description.
+ * @param exact If true, an approximate match is not accepted.
+ * @return The 1-based index of the task (not checked for numbers), or -1 if the
+ *         text does not resolve to one task.
+ */
+int resolveTask(const vector<Task>& tasks, const string& reference, bool openOnly, bool exact = false) {
+    if (!reference.empty() && reference.find_first_not_of("0123456789") == string::npos) {
+        return atoi(reference.c_str());
+    }
+    if (reference.size() > 1 && reference[0] == '#' && reference.find_first_not_of("0123456789", 1) == string::npos) {
+        auto positions = positionsById(tasks);
+        auto it = positions.find(static_cast<unsigned>(atoi(reference.c_str() + 1)));
+        if (it == positions.end()) {
+            cout << "No task with ID " << reference.substr(1) << "." << endl;
+            return -1;
+        }
+        return static_cast<int>(it->second) + 1;
+    }
+    vector<FuzzyMatch> matches = fuzzyFind(tasks, reference, openOnly, 5);
+    if (matches.empty()) {
+        cout << "No task matches '" << reference << "'." << endl;
+        return -1;
+    }
+    bool equal = normalizeDescription(tasks[matches[0].position].description) == normalizeDescription(reference);
+    if (exact && !equal) {
+        cout << "No task named '" << reference << "'. Did you mean:" << endl;
+        for (const FuzzyMatch& match : matches) {
+            cout << "  " << formatTask(tasks[match.position], match.position + 1) << endl;
+        }
+        return -1;
+    }
+    if (matches.size() > 1 && matches[1].distance == matches[0].distance && (!equal || exact)) {
+        cout << "'" << reference << "' matches several tasks:" << endl;
+        for (const FuzzyMatch& match : matches) {
+            cout << "  " << formatTask(tasks[match.position], match.position + 1) << endl;
+        }
+        return -1;
+    }
+    return static_cast<int>(matches[0].position) + 1;
+}
+
+std::string COMPLETION_FILENAME = getExecutableDirectory() + "\\todo.complete"; /**< File path of the completion index */
+
+const uint32_t COMPLETION_MAGIC = 0x31435854;  /**< Identifies a completion index file ("TXC1"). */
+const size_t COMPLETION_LIMIT = 20;            /**< The maximum number of completions printed. */
+
+/**
+ * @brief Compares two strings ignoring ASCII case.
+ * @param a The first string.
+ * @param b The second string.
+ * @return A negative number, zero or a positive number, like strcmp.
+ */
+int compareFolded(string_view a, string_view b) {
+    size_t n = min(a.size(), b.size());
+    for (size_t i = 0; i < n; ++i) {
+        int x = tolower(static_cast<unsigned char>(a[i]));
+        int y = tolower(static_cast<unsigned char>(b[i]));
+        if (x != y) return x - y;
+    }
+    return a.size() < b.size() ? -1 : a.size() > b.size() ? 1 : 0;
+}
+
+/**
+ * @struct CompletionIndex
+ * @brief The completion keys of all tasks, sorted ignoring case.
+ *
+ * Every task has two keys: its description and `#ID`. On disk the keys follow
+ * a table of their offsets, so a prefix is found by binary search with a few
+ * small reads, whatever the size of the list.
+ */
+struct CompletionIndex {
+    bool loaded = false;                     /**< Whether the index file has been read. */
+    bool valid = false;                      /**< Whether the index matches the current task file. */
+    vector<pair<string, unsigned>> entries;  /**< (key, task ID) pairs in key order. */
+};
+
+CompletionIndex completionIndex; /**< The completion index, loaded on first use by loadCompletions(). */
+
+/**
+ * @brief Orders completion entries by key ignoring case, then by task ID.
+ * @param a The first entry.
+ * @param b The second entry.
+ * @return true if a comes before b.
+ */
+bool completionBefore(const pair<string, unsigned>& a, const pair<string, unsigned>& b) {
+    int cmp = compareFolded(a.first, b.first);
+    return cmp != 0 ? cmp < 0 : a.second < b.second;
+}
+
+/**
+ * @brief Reads the header of the completion index file.
+ * @param file The open index file.
+ * @param count Receives the number of keys.
+ * @return The offset of the offset table, or 0 if the index does not match the task file.
+ */
+long long readCompletionHeader(FILE* file, uint64_t& count) {
+    uint32_t header[2];
+    if (!readAt(file, 0, header, sizeof(header)) || header[0] != COMPLETION_MAGIC || header[1] > 64) return 0;
+    string stamp(header[1], '\0');
+    if (fread(&stamp[0], 1, stamp.size(), file) != stamp.size() || fread(&count, 1, sizeof(count), file) != sizeof(count)) return 0;
+    if (stamp != taskFileStamp()) return 0;
+    return static_cast<long long>(sizeof(header) + stamp.size() + sizeof(count));
+}
+
+/**
+ * @brief Reads one key of the completion index file.
+ * @param file The open index file.
+ * @param table The offset of the offset table.
+ * @param i The key number.
+ * @param key Receives the key, or its first maxLength bytes.
+ * @param id Receives the task ID.
+ * @param maxLength The maximum number of key bytes to read.
+ * @return false if the file is too short.
+ */
+bool readCompletion(FILE* file, long long table, uint64_t i, string& key, unsigned& id, size_t maxLength = SIZE_MAX) {
+    uint64_t offset;
+    uint32_t head[2];  // task ID, key length
+    if (!readAt(file, table + static_cast<long long>(i * 8), &offset, 8) || !readAt(file, static_cast<long long>(offset), head, sizeof(head))) {
+        return false;
+    }
+    id = head[0];
+    key.resize(min<size_t>(head[1], maxLength));
+    return fread(&key[0], 1, key.size(), file) == key.size();
+}
+
+/**
+ * @brief Loads the completion index unless it is already loaded.
+ *
+ * The index is only trusted if the task file has not changed since it was written.
+ */
+void loadCompletions() {
+    if (completionIndex.loaded) return;
+    completionIndex.loaded = true;
+    FILE* file = fopen(COMPLETION_FILENAME.c_str(), "rb");
+    if (!file) return;
+    uint64_t count = 0;
+    long long table = readCompletionHeader(file, count);
+    if (table != 0) {
+        completionIndex.valid = fseek(file, static_cast<long>(table + static_cast<long long>(count * 8)), SEEK_SET) == 0;
+        completionIndex.entries.reserve(count);
+        for (uint64_t i = 0; completionIndex.valid && i < count; ++i) {
+            uint32_t head[2];
+            completionIndex.valid = fread(head, 1, sizeof(head), file) == sizeof(head);
+            string key(completionIndex.valid ? head[1] : 0, '\0');
+            completionIndex.valid = completionIndex.valid && fread(&key[0], 1, key.size(), file) == key.size();
+            completionIndex.entries.push_back({move(key), head[0]});
+        }
+    }
+    fclose(file);
+    if (!completionIndex.valid) completionIndex.entries.clear();
+}
+
+/**
+ * @brief Writes the completion index to the index file.
+ */
+void saveCompletions() {
+    FILE* file = fopen(COMPLETION_FILENAME.c_str(), "wb");
+    if (!file) return;
+    string stamp = taskFileStamp();
+    uint32_t header[2] = {COMPLETION_MAGIC, static_cast<uint32_t>(stamp.size())};
+    uint64_t count = completionIndex.entries.size();
+    fwrite(header, 1, sizeof(header), file);
+    fwrite(stamp.data(), 1, stamp.size(), file);
+    fwrite(&count, 1, sizeof(count), file);
+    uint64_t offset = sizeof(header) + stamp.size() + sizeof(count) + count * 8;
+    for (const auto& entry : completionIndex.entries) {
+        fwrite(&offset, 1, sizeof(offset), file);
+        offset += 8 + entry.first.size();
+    }
+    for (const auto& entry : completionIndex.entries) {
+        uint32_t head[2] = {entry.second, static_cast<uint32_t>(entry.first.size())};
+        fwrite(head, 1, sizeof(head), file);
+        fwrite(entry.first.data(), 1, entry.first.size(), file);
+    }
+    fclose(file);
+}
+
+/**
+ * @brief Rebuilds the completion index from a task list.
+ *
+ * Only needed when the task file was changed outside this program.
+ * @param tasks The vector of tasks.
+ */
+void rebuildCompletions(const vector<Task>& tasks) {
+    completionIndex.entries.clear();
+    completionIndex.entries.reserve(tasks.size() * 2);
+    for (const Task& task : tasks) {
+        completionIndex.entries.push_back({task.description, task.id});
+        completionIndex.entries.push_back({"#" + to_string(task.id), task.id});
+    }
+    sort(completionIndex.entries.begin(), completionIndex.entries.end(), completionBefore);
+    completionIndex.valid = true;
+}
+
+/**
+ * @brief Adjusts the completion index for one task change.
+ * @param change The kind of change.
+ * @param task The task after the change (before it, for removals).
+ */
+void updateCompletions(Change change, const Task& task) {
+    loadCompletions();
+    if (!completionIndex.valid || (change != Change::Added && change != Change::Removed)) return;
+    for (const auto& entry : {make_pair(task.description, task.id), make_pair("#" + to_string(task.id), task.id)}) {
+        auto it = lower_bound(completionIndex.entries.begin(), completionIndex.entries.end(), entry, completionBefore);
+        if (change == Change::Added) {
+            completionIndex.entries.insert(it, entry);
+        } else if (it != completionIndex.entries.end() && *it == entry) {
+            completionIndex.entries.erase(it);
+        }
+    }
+}
+
+/**
+ * @brief Prints the descriptions and `#ID` references that start with a prefix.
+ *
+ * Binary-searches the completion index file for the first key with the prefix
+ * and reads the following keys, so only a few dozen small reads are needed. If
+ * the index is missing or out of date, it is rebuilt from the task file first.
+ * @param prefix The prefix, compared ignoring case.
+ */
+void completeTasks(const string& prefix) {
+    if (!filesystem::exists(FILENAME)) return;
+    FILE* file = fopen(COMPLETION_FILENAME.c_str(), "rb");
+    uint64_t count = 0;
+    long long table = file ? readCompletionHeader(file, count) : 0;
+    if (table == 0) {
+        if (file) fclose(file);
+        vector<Task> tasks;
+        loadTasksFromFile(tasks);
+        rebuildCompletions(tasks);
+        saveCompletions();
+        file = fopen(COMPLETION_FILENAME.c_str(), "rb");
+        table = file ? readCompletionHeader(file, count) : 0;
+        if (table == 0) {
+            if (file) fclose(file);
+            return;
+        }
+    }
+    string key;
+    unsigned id;
+    uint64_t low = 0, high = count;
+    while (low < high) {
+        uint64_t middle = low + (high - low) / 2;
+        if (!readCompletion(file, table, middle, key, id, prefix.size())) break;
+        if (compareFolded(key, prefix) < 0) low = middle + 1;
+        else high = middle;
+    }
+    string last;
+    for (uint64_t i = low, printed = 0; i < count && printed < COMPLETION_LIMIT; ++i) {
+        if (!readCompletion(file, table, i, key, id) || compareFolded(string_view(key).substr(0, prefix.size()), prefix) != 0) break;
+        if (printed > 0 && key == last) continue;  // tasks with the same description
+        cout << key << endl;
+        last = key;
+        ++printed;
+    }
+    fclose(file);
+}
+
+/**
+ * @brief The input formats accepted by `todo import`.
+ */
+enum class ImportFormat { Ndjson, Csv, TodoTxt };
+
+const size_t IMPORT_CHUNK = 1 << 20;  /**< The number of bytes read from the input at a time. */
+const size_t IMPORT_BATCH = 4 << 20;  /**< The number of bytes of task lines appended to the task file at a time. */
+
+/**
+ * @class RecordReader
+ * @brief Splits a stream into records without copying them.
+ *
+ * The input is read in large chunks; each record is returned as a view into the
+ * chunk buffer, valid until the next call. The buffer only grows if a single
+ * record is larger than it, so memory use does not depend on the input size.
+ * In CSV mode line breaks inside quoted fields do not end a record.
+ */
+class RecordReader {
+public:
+    /**
+     * @brief Constructs a reader.
+     * @param in The input stream.
+     * @param csv Whether quoted fields may contain line breaks.
+     */
+    RecordReader(istream& in, bool csv) : in(in), csv(csv), buffer(IMPORT_CHUNK), begin(0), scan(0), end(0), consumed(0), quoted(false), eof(false) {}
+
+    /**
+     * @brief Reads the next record.
+     * @param record Receives the record, without its line break.
+     * @return false at the end of the input.
+     */
+    bool next(string_view& record) {
+        while (true) {
+            if (csv) {
+                for (; scan < end; ++scan) {
+                    if (buffer[scan] == '"') quoted = !quoted;
+                    else if (buffer[scan] == '\n' && !quoted) break;
+                }
+            } else {
+                const void* newline = memchr(buffer.data() + scan, '\n', end - scan);
+                scan = newline ? static_cast<const char*>(newline) - buffer.data() : end;
+            }
+            if (scan < end || (eof && begin < end)) {
+                record = string_view(buffer.data() + begin, scan - begin);
+                if (!record.empty() && record.back() == '\r') record.remove_suffix(1);
+                begin = scan = min(scan + 1, end);
+                return true;
+            }
+            if (eof) return false;
+            if (begin > 0) {
+                memmove(buffer.data(), buffer.data() + begin, end - begin);
+                scan -= begin;
+                end -= begin;
+                begin = 0;
+            }
+            if (end == buffer.size()) buffer.resize(buffer.size() * 2);  // a record longer than the buffer
+            in.read(buffer.data() + end, static_cast<streamsize>(buffer.size() - end));
+            size_t got = static_cast<size_t>(in.gcount());
+            end += got;
+            consumed += got;
+            eof = got == 0;
+        }
+    }
+
+    /**
+     * @brief Returns the number of input bytes read so far.
+     * @return The number of bytes.
+     */
+    size_t bytesRead() const { return consumed; }
+
+private:
+    istream& in;
+    bool csv;
+    vector<char> buffer;
+    size_t begin;     // start of the next record
+    size_t scan;      // end of the bytes already searched for a line break
+    size_t end;       // end of the bytes in the buffer
+    size_t consumed;
+    bool quoted;
+    bool eof;
+};
+
+/**
+ * @brief Appends a code point to a string as UTF-8.
+ * @param out The string to append to.
+ * @param code The code point.
+ */
+void appendUtf8(string& out, unsigned code) {
+    if (code < 0x80) {
+        out += static_cast<char>(code);
+    } else if (code < 0x800) {
+        out += static_cast<char>(0xC0 | (code >> 6));
+        out += static_cast<char>(0x80 | (code & 0x3F));
+    } else if (code < 0x10000) {
+        out += static_cast<char>(0xE0 | (code >> 12));
+        out += static_cast<char>(0x80 | ((code >> 6) & 0x3F));
+        out += static_cast<char>(0x80 | (code & 0x3F));
+    } else {
+        out += static_cast<char>(0xF0 | (code >> 18));
+        out += static_cast<char>(0x80 | ((code >> 12) & 0x3F));
+        out += static_cast<char>(0x80 | ((code >> 6) & 0x3F));
+        out += static_cast<char>(0x80 | (code & 0x3F));
+    }
+}
+
+/**
+ * @class JsonScanner
+ * @brief A SAX-style parser for one NDJSON record.
+ *
+ * Reports every top-level field of the object to a handler; array elements are
+ * reported one by one under the array's name and nested objects are skipped.
+ * Strings without escapes are passed as views into the record, so only escaped
+ * strings are copied.
+ */
+class JsonScanner {
+public:
+    /**
+     * @brief Constructs a scanner for a record.
+     * @param text The record.
+     */
+    explicit JsonScanner(string_view text) : text(text), pos(0) {}
+
+    /**
+     * @brief Parses the record.
+     * @param onField Called with the field name and each scalar value; `true`,
+     *                `false` and numbers are passed as written, `null` is skipped.
+     * @param error Receives a description of the first syntax error.
+     * @return false if the record is not a valid JSON object.
+     */
+    template <typename Handler>
+    bool parse(Handler onField, string& error) {
+        if (!expect('{', error)) return false;
+        if (peek() == '}') return finish(error);
+        while (true) {
+            string_view name;
+            if (!readString(name, keyScratch, error) || !expect(':', error)) return false;
+            char c = peek();
+            if (c == '[') {
+                ++pos;
+                if (peek() == ']') {
+                    ++pos;
+                } else {
+                    while (true) {
+                        if (!value(name, onField, error)) return false;
+                        if (peek() == ']') {
+                            ++pos;
+                            break;
+                        }
+                        if (!expect(',', error)) return false;
+                    }
+                }
+            } else if (!value(name, onField, error)) {
+                return false;
+            }
+            if (peek() == '}') return finish(error);
+            if (!expect(',', error)) return false;
+        }
+    }
+
+private:
+    string_view text;
+    size_t pos;
+    string keyScratch;
+    string valueScratch;
+
+    char peek() {
+        while (pos < text.size() && isspace(static_cast<unsigned char>(text[pos]))) ++pos;
+        return pos < text.size() ? text[pos] : '\0';
+    }
+
+    bool expect(char c, string& error) {
+        if (peek() != c) {
+            error = string("expected '") + c + "' at column " + to_string(pos + 1);
+            return false;
+        }
+        ++pos;
+        return true;
+    }
+
+    bool finish(string& error) {
+        ++pos;
+        if (peek() != '\0') {
+            error = "unexpected text after the object at column " + to_string(pos + 1);
+            return false;
+        }
+        return true;
+    }
+
+    bool readString(string_view& out, string& scratch, string& error) {
+        if (!expect('"', error)) return false;
+        size_t start = pos;
+        while (pos < text.size() && text[pos] != '"' && text[pos] != '\\') ++pos;
+        if (pos < text.size() && text[pos] == '"') {
+            out = text.substr(start, pos++ - start);
+            return true;
+        }
+        scratch.assign(text.data() + start, pos - start);
+        while (pos < text.size() && text[pos] != '"') {
+            char c = text[pos++];
+            if (c != '\\') {
+                scratch += c;
+                continue;
+            }
+            if (pos >= text.size()) break;
+            char e = text[pos++];
+            if (e == 'n') scratch += '\n';
+            else if (e == 't') scratch += '\t';
+            else if (e == 'r') scratch += '\r';
+            else if (e == 'b') scratch += '\b';
+            else if (e == 'f') scratch += '\f';
+            else if (e == 'u' && pos + 4 <= text.size()) {
+                unsigned code = static_cast<unsigned>(strtoul(string(text.substr(pos, 4)).c_str(), nullptr, 16));
+                pos += 4;
+                if (code >= 0xD800 && code < 0xDC00 && pos + 6 <= text.size() && text[pos] == '\\' && text[pos + 1] == 'u') {
+                    unsigned low = static_cast<unsigned>(strtoul(string(text.substr(pos + 2, 4)).c_str(), nullptr, 16));
+                    pos += 6;
+                    code = 0x10000 + ((code - 0xD800) << 10) + (low - 0xDC00);
+                }
+                appendUtf8(scratch, code);
+            } else scratch += e;
+        }
+        if (pos >= text.size()) {
+            error = "unterminated string";
+            return false;
+        }
+        ++pos;
+        out = scratch;
+        return true;
+    }
+
+    template <typename Handler>
+    bool value(string_view name, Handler& onField, string& error) {
+        char c = peek();
+        if (c == '"') {
+            string_view v;
+            if (!readString(v, valueScratch, error)) return false;
+            onField(name, v);
+            return true;
+        }
+        if (c == '{' || c == '[') return skip(error);
+        size_t start = pos;
+        while (pos < text.size() && (isalnum(static_cast<unsigned char>(text[pos])) || text[pos] == '-' || text[pos] == '+' || text[pos] == '.')) ++pos;
+        string_view literal = text.substr(start, pos - start);
+        if (literal != "true" && literal != "false" && literal != "null") {
+            string number(literal);
+            char* parsed = nullptr;
+            strtod(number.c_str(), &parsed);
+            if (number.empty() || parsed != number.c_str() + number.size()) {
+                error = "unexpected value at column " + to_string(start + 1);
+                return false;
+            }
+        }
+        if (literal != "null") onField(name, literal);
+        return true;
+    }
+
+    bool skip(string& error) {
+        int depth = 0;
+        string_view ignored;
+        while (pos < text.size()) {
+            char c = peek();
+            if (c == '"') {
+                if (!readString(ignored, valueScratch, error)) return false;
+                continue;
+            }
+            ++pos;
+            if (c == '{' || c == '[') ++depth;
+            else if ((c == '}' || c == ']') && --depth == 0) return true;
+        }
+        error = "unterminated object or array";
+        return false;
+    }
+};
+
+/**
+ * @brief Splits a CSV record into fields.
+ *
+ * Unquoted fields and quoted fields without doubled quotes are returned as views
+ * into the record; the others are unescaped into scratch strings.
+ * @param record The record.
+ * @param fields Receives the fields.
+ * @param scratch Storage for unescaped fields, reused between records.
+ * @return false if a quoted field is not terminated.
+ */
+bool splitCsv(string_view record, vector<string_view>& fields, vector<string>& scratch) {
+    fields.clear();
+    size_t used = 0;
+    size_t pos = 0;
+    while (true) {
+        if (pos < record.size() && record[pos] == '"') {
+            size_t start = ++pos;
+            bool escaped = false;
+            while (true) {
+                size_t quote = record.find('"', pos);
+                if (quote == string_view::npos) return false;
+                if (quote + 1 < record.size() && record[quote + 1] == '"') {
+                    escaped = true;
+                    pos = quote + 2;
+                    continue;
+                }
+                pos = quote + 1;
+                break;
+            }
+            string_view field = record.substr(start, pos - 1 - start);
+            if (escaped) {
+                if (used == scratch.size()) scratch.emplace_back();
+                string& out = scratch[used++];
+                out.clear();
+                for (size_t i = 0; i < field.size(); ++i) {
+                    out += field[i];
+                    if (field[i] == '"') ++i;
+                }
+                field = out;
+            }
+            fields.push_back(field);
+            pos = record.find(',', pos);
+        } else {
+            size_t comma = record.find(',', pos);
+            fields.push_back(record.substr(pos, comma == string_view::npos ? string_view::npos : comma - pos));
+            pos = comma;
+        }
+        if (pos == string_view::npos) return true;
+        ++pos;
+    }
+}
+
+/**
+ * @brief Applies one imported field to a task.
+ *
+ * Recognizes the fields written by `--json` and the usual names used by other
+ * trackers; unknown fields are ignored.
+ * @param task The task being imported.
+ * @param tags Receives tags given in a separate field.
+ * @param name The field name.
+ * @param value The field value.
+ */
+void applyImportField(Task& task, vector<string>& tags, string_view name, string_view value) {
+    string key = toLower(string(name));
+    long count;
+    char unit;
+    if (key == "description" || key == "text" || key == "title" || key == "task" || key == "summary") {
+        string description(value);
+        replace_if(description.begin(), description.end(), [](char c) { return c >= 0 && c < ' '; }, ' ');  // one task per line
+        task.description = trim(description);
+    } else if (key == "completed" || key == "done") {
+        task.completed = value == "true" || value == "1" || value == "yes" || value == "x";
+    } else if (key == "status" || key == "state") {
+        string status = toLower(string(value));
+        task.completed = status == "done" || status == "completed" || status == "closed" || status == "resolved" || status == "x";
+    } else if (key == "priority" || key == "pri") {
+        if (value.size() == 1 && isalpha(static_cast<unsigned char>(value[0]))) {
+            task.priority = min(toupper(static_cast<unsigned char>(value[0])) - 'A' + 1, 9);
+        } else if (!value.empty()) {
+            int priority = atoi(string(value).c_str());
+            if (priority >= 1 && priority <= 9) task.priority = priority;
+        }
+    } else if (key == "due" || key == "created") {
+        string date(value.substr(0, 10));
+        if (isDate(date)) (key == "due" ? task.due : task.created) = date;
+    } else if (key == "every" || key == "repeat") {
+        if (parseInterval(string(value), count, unit)) task.every = string(value);
+    } else if (key == "tags" || key == "tag") {
+        string word;
+        for (size_t i = 0; i <= value.size(); ++i) {
+            if (i == value.size() || value[i] == ' ' || value[i] == ',' || value[i] == ';') {
+                if (!word.empty()) tags.push_back(word);
+                word.clear();
+            } else if (value[i] != '+' || !word.empty()) {
+                word += value[i];
+            }
+        }
+    }
+}
+
+/**
+ * @brief Parses one line in todo.txt format.
+ *
+ * Lines written by this program (`0`/`1`, the description and attributes) keep
+ * their attributes except list links, which refer to IDs of the other list.
+ * Other lines are read as todo.txt: an optional `x` and completion date, an
+ * optional `(A)` priority and creation date, then the task text with `pri:`,
+ * `due:` and `every:` words as accepted by `todo add`.
+ * @param line The line.
+ * @return The task.
+ */
+Task parseTodoTxtLine(const string& line) {
+    if (line.size() > 1 && (line[0] == '0' || line[0] == '1') && line[1] == ' ') {
+        Task task = parseTaskLine(line);
+        task.id = task.parent = task.blockers = 0;
+        task.after.clear();
+        task.blocks.clear();
+        task.started = 0;
+        return task;
+    }
+    Task task("");
+    stringstream ss(line);
+    string word;
+    string rest;
+    ss >> word;
+    if (word == "x") {
+        task.completed = true;
+        ss >> word;
+        if (isDate(word)) ss >> word;
+    }
+    if (word.size() == 3 && word[0] == '(' && word[2] == ')' && isupper(static_cast<unsigned char>(word[1]))) {
+        task.priority = min(word[1] - 'A' + 1, 9);
+        ss >> word;
+    }
+    if (isDate(word)) {
+        task.created = word;
+        word.clear();
+    }
+    getline(ss, rest);
+    parseTaskText(word + rest, task);
+    return task;
+}
+
+/**
+ * @brief Imports tasks from a file in bulk.
+ *
+ * The input is parsed as a stream, one record at a time, and the new tasks are
+ * appended to the task file in large batches, so memory use is bounded no
+ * matter how large the input is. The existing tasks are never loaded. If a
+ * record cannot be parsed, the task file is truncated back to its previous
+ * size, so either every task is imported or none is. Saved views are updated
+ * once per written batch, the result cache and the statistics once at the end.
+ *
+ * The format is chosen by the file extension (`.csv`, `.json`, `.jsonl` or
+ * `.ndjson`, anything else is todo.txt); CSV files need a header row.
+ * @param path The file to import.
+ * @return false if the file could not be read or parsed.
+ */
+bool importTasks(const string& path) {
+    ifstream in(path, ios::binary);
+    if (!in.is_open()) {
+        cout << "Could not open " << path << "." << endl;
+        return false;
+    }
+    string extension = toLower(filesystem::path(path).extension().string());
+    ImportFormat format = extension == ".csv" ? ImportFormat::Csv
+                        : extension == ".json" || extension == ".jsonl" || extension == ".ndjson" ? ImportFormat::Ndjson
+                        : ImportFormat::TodoTxt;
+
+    // New IDs continue after the highest ID in the task file or handed out before
+    unsigned nextId = 1;
+    error_code ec;
+    bool existed = filesystem::exists(FILENAME, ec);
+    uintmax_t previousSize = existed ? filesystem::file_size(FILENAME, ec) : 0;
+    bool newline = true;
+    {
+        ifstream existing(FILENAME, ios::binary);
+        string line;
+        while (getline(existing, line)) {
+            size_t at = line.find("\tid=");
+            if (at != string::npos) nextId = max(nextId, static_cast<unsigned>(atoi(line.c_str() + at + 4)) + 1);
+            newline = !existing.eof();
+        }
+    }
+    nextId = newTaskId(nextId - 1);
+
+    prepareSidecars();
+    bool stats = taskStats.valid;
+    // Matching tasks are merged into the saved views once per written batch
+    const unsigned firstId = nextId;
+    vector<vector<pair<string, unsigned>>> viewRows(savedViews.size());
+    auto mergeViewRows = [&] {
+        for (size_t v = 0; v < savedViews.size(); ++v) {
+            SavedView& view = savedViews[v];
+            if (viewRows[v].empty()) continue;
+            auto before = [&](const pair<string, unsigned>& a, const pair<string, unsigned>& b) {
+                return viewRowBefore(view.query, a, b);
+            };
+            stable_sort(viewRows[v].begin(), viewRows[v].end(), before);
+            size_t middle = view.rows.size();
+            view.rows.insert(view.rows.end(), viewRows[v].begin(), viewRows[v].end());
+            inplace_merge(view.rows.begin(), view.rows.begin() + middle, view.rows.end(), before);
+            viewRows[v].clear();
+            viewsChanged = true;
+        }
+    };
+    ofstream store(FILENAME, ios::binary | ios::app);
+    ostringstream batch;
+    if (!newline) batch << '\n';
+
+    RecordReader reader(in, format == ImportFormat::Csv);
+    uintmax_t inputSize = filesystem::file_size(path, ec);
+    vector<string> header;
+    vector<string_view> fields;
+    vector<string> scratch;
+    vector<string> tags;
+    string error;
+    string_view record;
+    string date = today();
+    size_t line = 0;
+    size_t imported = 0;
+    bool progress = false;
+    while (reader.next(record)) {
+        ++line;
+        if (record.find_first_not_of(" \t") == string_view::npos) continue;
+        Task task("");
+        tags.clear();
+        auto apply = [&](string_view name, string_view value) { applyImportField(task, tags, name, value); };
+        if (format == ImportFormat::Ndjson) {
+            if (!JsonScanner(record).parse(apply, error)) break;
+        } else if (format == ImportFormat::Csv) {
+            if (!splitCsv(record, fields, scratch)) {
+                error = "unterminated quoted field";
+                break;
+            }
+            if (header.empty()) {
+                for (string_view field : fields) header.push_back(trim(string(field)));
+                if (header[0].compare(0, 3, "\xEF\xBB\xBF") == 0) header[0].erase(0, 3);  // UTF-8 byte order mark
+                continue;
+            }
+            for (size_t i = 0; i < fields.size() && i < header.size(); ++i) apply(header[i], fields[i]);
+        } else {
+            task = parseTodoTxtLine(string(record));
+        }
+        if (task.description.empty()) {
+            error = "the task has no description";
+            break;
+        }
+        if (!tags.empty()) {
+            vector<string> existing = taskTags(task);
+            for (const string& tag : tags) {
+                if (find(existing.begin(), existing.end(), toLower(tag)) == existing.end()) task.description += " +" + tag;
+            }
+        }
+        if (task.created.empty()) task.created = date;
+        if (!task.every.empty()) {
+            if (task.due.empty()) task.due = task.created;
+            if (task.since.empty()) task.since = task.due;
+        }
+        task.id = nextId++;
+        writeTaskLine(batch, task);
+        if (stats) updateStats(Change::Added, task);
+        for (size_t v = 0; v < savedViews.size(); ++v) {
+            const Query& query = savedViews[v].query;
+            if (!query.where || matchesQuery(*query.where, task)) {
+                viewRows[v].push_back({query.ordered ? sortKey(task, query.orderBy) : "", task.id});
+            }
+        }
+        ++imported;
+        if (batch.tellp() >= static_cast<streamoff>(IMPORT_BATCH)) {
+            store << batch.str();
+            batch.str("");
+            mergeViewRows();
+        }
+        if (imported % 100000 == 0 && inputSize > 0) {
+            cerr << "\rImported " << imported << " tasks (" << reader.bytesRead() * 100 / inputSize << "%)" << flush;
+            progress = true;
+        }
+    }
+    if (progress) cerr << "\r" << string(40, ' ') << "\r" << flush;
+
+    if (error.empty()) {
+        store << batch.str();
+        store.close();
+    }
+    if (!error.empty() || !store) {
+        store.close();
+        if (existed) {
+            filesystem::resize_file(FILENAME, previousSize, ec);
+        } else {
+            filesystem::remove(FILENAME, ec);
+        }
+        for (SavedView& view : savedViews) {  // rows merged from earlier batches
+            view.rows.erase(remove_if(view.rows.begin(), view.rows.end(),
+                                      [&](const pair<string, unsigned>& row) { return row.second >= firstId; }),
+                            view.rows.end());
+        }
+        if (error.empty()) {
+            cout << "Could not write " << FILENAME << ". Nothing was imported." << endl;
+        } else {
+            cout << path << ":" << line << ": " << error << ". Nothing was imported." << endl;
+        }
+        return false;
+    }
+
+    mergeViewRows();
+    if (imported > 0) {
+        lastTaskId = nextId - 1;
+        saveLastTaskId();
+        advanceGenerations(Change::Added);
+        recordImport(imported);
+    }
+    if (viewsChanged) saveViews();
+    if (stats) saveStats();  // otherwise recounted by the next `todo stats`
+    saveCache();
+    cout << "Imported " << imported << (imported == 1 ? " task." : " tasks.") << endl;
+    return true;
+}
+
+/**
+ * @brief The fields `todo export` can write, in their default order.
+ */
+const vector<string> EXPORT_FIELDS = {"id", "status", "description", "tags", "priority", "due", "created",
+                                      "parent", "after", "blocks", "every", "since", "spent"};
+
+const size_t EXPORT_BUFFER = 1 << 20; /**< The size of the export write buffer in bytes. */
+
+/**
+ * @brief Writes a CSV field, quoting it if needed.
+ * @param buffer The buffer to write to.
+ * @param value The field value.
+ */
+void writeCsvField(OutputBuffer& buffer, string_view value) {
+    if (value.find_first_of(",\"\r\n") == string_view::npos) {
+        buffer.write(value.data(), value.size());
+        return;
+    }
+    buffer.put('"');
+    size_t run = 0;
+    for (size_t quote = value.find('"'); quote != string_view::npos; quote = value.find('"', quote + 1)) {
+        buffer.write(value.data() + run, quote + 1 - run);
+        buffer.put('"');
+        run = quote + 1;
+    }
+    buffer.write(value.data() + run, value.size() - run);
+    buffer.put('"');
+}
+
+/**
+ * @brief Exports tasks as CSV or NDJSON.
+ *
+ * Lines of the task file are split into attribute views and only the requested
+ * fields are written, so no Task objects are built. Output goes through a large
+ * write buffer; when it targets a pipe, a full pipe blocks the export until the
+ * reader catches up, and the export stops if the reader goes away.
+ * @param format `csv` or `ndjson`.
+ * @param fields Comma-separated field names, or empty for all fields.
+ * @param path The output file, or empty for standard output.
+ * @return false if the options are invalid or the output could not be written.
+ */
+bool exportTasks(const string& format, const string& fields, const string& path) {
+    if (format != "csv" && format != "ndjson") {
+        cout << "Unknown export format '" << format << "'. Use csv or ndjson." << endl;
+        return false;
+    }
+    vector<size_t> columns;
+    stringstream list(fields);
+    string name;
+    while (getline(list, name, ',')) {
+        name = toLower(trim(name));
+        auto it = find(EXPORT_FIELDS.begin(), EXPORT_FIELDS.end(), name);
+        if (it == EXPORT_FIELDS.end()) {
+            cout << "Unknown field '" << name << "'." << endl;
+            return false;
+        }
+        columns.push_back(it - EXPORT_FIELDS.begin());
+    }
+    if (columns.empty()) {
+        for (size_t i = 0; i < EXPORT_FIELDS.size(); ++i) columns.push_back(i);
+    }
+
+    ifstream in(FILENAME, ios::binary);
+    if (!in.is_open()) {
+        cout << "No saved tasks found." << endl;
+        return false;
+    }
+    FILE* target = stdout;
+    if (!path.empty()) {
+        target = fopen(path.c_str(), "wb");
+        if (!target) {
+            cout << "Could not open " << path << "." << endl;
+            return false;
+        }
+    } else {
+        output.flush();
+    }
+
+    enum { Id, Status, Description, Tags, Priority, Due, Created, Parent, After, Blocks, Every, Since, Spent };
+    const size_t numeric[] = {Id, Priority, Parent, Spent};
+    bool csv = format == "csv";
+    bool wantTags = find(columns.begin(), columns.end(), static_cast<size_t>(Tags)) != columns.end();
+    size_t exported = 0;
+    bool written;
+    {
+        OutputBuffer sink(target, EXPORT_BUFFER);
+        if (csv) {
+            for (size_t i = 0; i < columns.size(); ++i) {
+                if (i > 0) sink.put(',');
+                sink.write(EXPORT_FIELDS[columns[i]]);
+            }
+            sink.put('\n');
+        }
+        RecordReader reader(in, false);
+        string_view line;
+        string_view values[13];
+        string tags;
+        while (sink.good() && reader.next(line)) {
+            if (line.empty()) continue;
+            for (string_view& value : values) value = string_view();
+            size_t tab = line.find('\t');
+            string_view head = line.substr(0, tab);
+            values[Status] = head[0] == '1' ? "done" : "open";
+            head.remove_prefix(min(head.find_first_not_of("01"), head.size()));
+            size_t first = head.find_first_not_of(" \r");
+            size_t last = head.find_last_not_of(" \r");
+            values[Description] = first == string_view::npos ? string_view() : head.substr(first, last - first + 1);
+            while (tab != string_view::npos) {
+                size_t next = line.find('\t', tab + 1);
+                string_view attribute = line.substr(tab + 1, next == string_view::npos ? string_view::npos : next - tab - 1);
+                size_t eq = attribute.find('=');
+                string_view key = attribute.substr(0, eq);
+                string_view value = eq == string_view::npos ? string_view() : attribute.substr(eq + 1);
+                if (key == "pri") key = "priority";
+                for (size_t i = 0; i < EXPORT_FIELDS.size(); ++i) {
+                    if (i != Status && i != Description && i != Tags && key == EXPORT_FIELDS[i]) values[i] = value;
+                }
+                tab = next;
+            }
+            tags.clear();
+            size_t firstTag = wantTags ? values[Description].find('+') : string_view::npos;
+            for (size_t plus = firstTag; plus != string_view::npos; plus = values[Description].find('+', plus + 1)) {
+                if (plus > 0 && values[Description][plus - 1] != ' ') continue;
+                size_t end = values[Description].find(' ', plus);
+                if (end == string_view::npos) end = values[Description].size();
+                if (end - plus < 2) continue;
+                if (!tags.empty()) tags += ' ';
+                tags.append(values[Description].data() + plus + 1, end - plus - 1);
+            }
+            values[Tags] = tags;
+
+            if (!csv) sink.put('{');
+            for (size_t i = 0; i < columns.size(); ++i) {
+                size_t column = columns[i];
+                string_view value = values[column];
+                if (csv) {
+                    if (i > 0) sink.put(',');
+                    writeCsvField(sink, value);
+                    continue;
+                }
+                if (i > 0) sink.put(',');
+                writeJsonString(EXPORT_FIELDS[column].data(), EXPORT_FIELDS[column].size(), sink);
+                sink.put(':');
+                if (column == Tags || column == After || column == Blocks) {
+                    char separator = column == Tags ? ' ' : ',';
+                    sink.put('[');
+                    size_t start = 0;
+                    while (start < value.size()) {
+                        size_t end = min(value.find(separator, start), value.size());
+                        if (start > 0) sink.put(',');
+                        if (column == Tags) writeJsonString(value.data() + start, end - start, sink);
+                        else sink.write(value.data() + start, end - start);
+                        start = end + 1;
+                    }
+                    sink.put(']');
+                } else if (find(begin(numeric), end(numeric), column) != end(numeric) && !value.empty() &&
+                           value.find_first_not_of("0123456789") == string_view::npos) {
+                    sink.write(value.data(), value.size());
+                } else if (value.empty() && column != Description) {
+                    sink.write("null");
+                } else {
+                    writeJsonString(value.data(), value.size(), sink);
+                }
+            }
+            sink.put(csv ? '\n' : '}');
+            if (!csv) sink.put('\n');
+            ++exported;
+        }
+        sink.flush();
+        written = sink.good();
+    }
+    if (target != stdout) written = fclose(target) == 0 && written;
+    if (!written) {
+        cout << "Could not write " << (path.empty() ? string("the output") : path) << "." << endl;
+        return false;
+    }
+    if (target != stdout) {
+        cout << "Exported " << exported << (exported == 1 ? " task to " : " tasks to ") << path << "." << endl;
+    }
+    return true;
+}
+
+const size_t SORT_MEMORY = 256;  /**< The default memory budget of `list --sort` in megabytes. */
+
+/**
+ * @struct SortRecord
+ * @brief A line of the task file with its precomputed sort key.
+ */
+struct SortRecord {
+    uint64_t prefix;   /**< The first 8 key bytes as a big-endian number, compared before the key. */
+    string key;        /**< The sort key; records are ordered by key, then by number. */
+    uint64_t number;   /**< The 1-based line number, shown as the task number. */
+    string line;       /**< The line of the task file. */
+    uint32_t file;     /**< The index of the task file the line comes from. */
+};
+
+/**
+ * @brief Orders sort records by key, then by line number.
+ * @param a The first record.
+ * @param b The second record.
+ * @return true if a comes before b.
+ */
+bool sortRecordBefore(const SortRecord& a, const SortRecord& b) {
+    if (a.prefix != b.prefix) return a.prefix < b.prefix;
+    int cmp = a.key.compare(b.key);
+    return cmp != 0 ? cmp < 0 : a.number < b.number;
+}
+
+/**
+ * @brief Computes the sort key of a line of the task file.
+ *
+ * Descriptions use a collation key (the description in lower case), so the
+ * comparisons during the sort are plain byte comparisons. Keys are computed
+ * once per line and kept with it, together with their first bytes as a number,
+ * which decides most comparisons without touching the key. IDs are padded to a
+ * fixed width; unset IDs, priorities and dates sort last.
+ * @param line The line.
+ * @param field `id`, `description`, `priority`, `due` or `created`.
+ * @return The key.
+ */
+string sortKeyOf(const string& line, const string& field) {
+    size_t tab = line.find('\t');
+    if (field == "description") {
+        size_t start = line.find(' ');
+        start = start == string::npos || start > tab ? min(tab, line.size()) : start + 1;
+        string key = line.substr(start, tab == string::npos ? string::npos : tab - start);
+        for (char& c : key) c = static_cast<char>(tolower(static_cast<unsigned char>(c)));
+        return key;
+    }
+    string name = field == "priority" ? "pri" : field;
+    while (tab != string::npos) {
+        size_t next = line.find('\t', tab + 1);
+        size_t eq = line.find('=', tab + 1);
+        if (eq != string::npos && (next == string::npos || eq < next) && line.compare(tab + 1, eq - tab - 1, name) == 0) {
+            string value = line.substr(eq + 1, next == string::npos ? string::npos : next - eq - 1);
+            if (field == "id" && value.size() < 10) value.insert(0, 10 - value.size(), '0');  // numeric order
+            return value;
+        }
+        tab = next;
+    }
+    return "~";  // after every date and priority
+}
+
+/**
+ * @brief Computes the comparison prefix of a sort key.
+ * @param key The sort key.
+ * @return The first 8 bytes of the key, padded with zeros, as a big-endian number.
+ */
+uint64_t sortPrefixOf(const string& key) {
+    uint64_t prefix = 0;
+    for (size_t i = 0; i < 8; ++i) {
+        prefix = prefix << 8 | (i < key.size() ? static_cast<unsigned char>(key[i]) : 0);
+    }
+    return prefix;
+}
+
+/**
+ * @brief Sorts records with several threads.
+ *
+ * Each thread sorts one slice; the sorted slices are then merged pairwise,
+ * the merges of one round running in parallel.
+ * @param records The records to sort.
+ */
+void parallelSort(vector<SortRecord>& records) {
+    size_t workers = max<size_t>(1, thread::hardware_concurrency());
+    size_t n = records.size();
+    if (workers == 1 || n < 1 << 16) {
+        sort(records.begin(), records.end(), sortRecordBefore);
+        return;
+    }
+    size_t slice = (n + workers - 1) / workers;
+    vector<thread> threads;
+    for (size_t begin = 0; begin < n; begin += slice) {
+        threads.emplace_back([&records, begin, end = min(begin + slice, n)] {
+            sort(records.begin() + begin, records.begin() + end, sortRecordBefore);
+        });
+    }
+    for (thread& t : threads) t.join();
+    for (size_t width = slice; width < n; width *= 2) {
+        threads.clear();
+        for (size_t begin = 0; begin + width < n; begin += 2 * width) {
+            threads.emplace_back([&records, begin, middle = begin + width, end = min(begin + 2 * width, n)] {
+                inplace_merge(records.begin() + begin, records.begin() + middle, records.begin() + end, sortRecordBefore);
+            });
+        }
+        for (thread& t : threads) t.join();
+    }
+}
+
+/**
+ * @brief Writes a sort record to a run file.
+ * @param out The run file.
+ * @param record The record.
+ */
+void writeSortRecord(ostream& out, const SortRecord& record) {
+    uint32_t sizes[3] = {static_cast<uint32_t>(record.key.size()), static_cast<uint32_t>(record.line.size()), record.file};
+    out.write(reinterpret_cast<const char*>(sizes), sizeof(sizes));
+    out.write(reinterpret_cast<const char*>(&record.number), sizeof(record.number));
+    out.write(record.key.data(), static_cast<streamsize>(record.key.size()));
+    out.write(record.line.data(), static_cast<streamsize>(record.line.size()));
+}
+
+/**
+ * @brief Reads a sort record from a run file.
+ * @param in The run file.
+ * @param record Receives the record.
+ * @return false at the end of the run.
+ */
+bool readSortRecord(istream& in, SortRecord& record) {
+    uint32_t sizes[3];
+    if (!in.read(reinterpret_cast<char*>(sizes), sizeof(sizes))) return false;
+    record.file = sizes[2];
+    in.read(reinterpret_cast<char*>(&record.number), sizeof(record.number));
+    record.key.resize(sizes[0]);
+    record.line.resize(sizes[1]);
+    in.read(&record.key[0], sizes[0]);
+    in.read(&record.line[0], sizes[1]);
+    record.prefix = sortPrefixOf(record.key);
+    return static_cast<bool>(in);
+}
+
+/**
+ * @brief Checks whether a field can be used to sort tasks.
+ * @param field The field name.
+ * @return true for `id`, `description`, `priority`, `due` and `created`.
+ */
+bool isSortField(const string& field) {
+    if (field == "id" || field == "description" || field == "priority" || field == "due" || field == "created") return true;
+    cout << "Unknown sort field '" << field << "'. Use id, description, priority, due or created." << endl;
+    return false;
+}
+
+/**
+ * @brief Streams the lines of task files in the order of a field.
+ *
+ * Reads the files one after the other as streams and keeps lines with their
+ * precomputed sort keys until the memory budget is reached. If all lines fit,
+ * the records are sorted in parallel and passed on. Otherwise each full buffer
+ * is sorted and written to a temporary run file, and the runs are combined with
+ * a k-way merge, so inputs larger than the memory budget can be sorted.
+ * Lines with equal keys keep their input order.
+ * @param paths The task files.
+ * @param field `id`, `description`, `priority`, `due` or `created`.
+ * @param memory The memory budget in megabytes.
+ * @param emit Receives the records in order (record.number counts the lines of
+ *             all files) and returns false to stop, e.g. when the output failed.
+ * @return false if a file cannot be opened.
+ */
+bool sortTaskLines(const vector<string>& paths, const string& field, size_t memory, const function<bool(const SortRecord&)>& emit) {
+    vector<ifstream> inputs;
+    for (const string& path : paths) {
+        inputs.emplace_back(path, ios::binary);
+        if (!inputs.back().is_open()) {
+            cout << "Cannot open '" << path << "'." << endl;
+            return false;
+        }
+    }
+    const size_t budget = memory << 20;
+    const size_t overhead = sizeof(SortRecord) + 32;  // per record, besides the key and line bytes
+    vector<SortRecord> records;
+    vector<string> runs;
+    size_t used = 0;
+    uint64_t number = 0;
+    string_view line;
+    auto spill = [&] {
+        parallelSort(records);
+        string path = (filesystem::temp_directory_path() / ("todo-sort-" + to_string(GetCurrentProcessId()) + "-" + to_string(runs.size()) + ".run")).string();
+        ofstream run(path, ios::binary);
+        for (const SortRecord& record : records) writeSortRecord(run, record);
+        runs.push_back(path);
+        records.clear();
+        used = 0;
+    };
+    for (size_t file = 0; file < inputs.size(); ++file) {
+        RecordReader reader(inputs[file], false);
+        while (reader.next(line)) {
+            ++number;
+            if (line.empty()) continue;
+            SortRecord record{0, "", number, string(line), static_cast<uint32_t>(file)};
+            record.key = sortKeyOf(record.line, field);
+            record.prefix = sortPrefixOf(record.key);
+            used += record.key.size() + record.line.size() + overhead;
+            records.push_back(move(record));
+            if (used >= budget) spill();
+        }
+    }
+
+    if (runs.empty()) {
+        parallelSort(records);
+        for (const SortRecord& record : records) {
+            if (!emit(record)) break;
+        }
+        return true;
+    }
+    if (!records.empty()) spill();
+    vector<ifstream> files;
+    for (const string& path : runs) files.emplace_back(path, ios::binary);
+    vector<SortRecord> heads(files.size());
+    auto after = [&](size_t a, size_t b) { return sortRecordBefore(heads[b], heads[a]); };
+    priority_queue<size_t, vector<size_t>, decltype(after)> queue(after);
+    for (size_t i = 0; i < files.size(); ++i) {
+        if (readSortRecord(files[i], heads[i])) queue.push(i);
+    }
+    while (!queue.empty()) {
+        size_t i = queue.top();
+        queue.pop();
+        if (!emit(heads[i])) break;
+        if (readSortRecord(files[i], heads[i])) queue.push(i);
+    }
+    files.clear();
+    error_code ec;
+    for (const string& path : runs) filesystem::remove(path, ec);
+    return true;
+}
+
+/**
+ * @brief Lists the tasks sorted by a field.
+ *
+ * The task file is sorted as a stream (see sortTaskLines()), so it may be
+ * larger than memory. Tasks keep their list numbers.
+ * @param field `id`, `description`, `priority`, `due` or `created`.
+ * @param memory The memory budget in megabytes.
+ * @return false if the field is unknown.
+ */
+bool listSorted(const string& field, size_t memory) {
+    if (!isSortField(field)) return false;
+    if (!filesystem::exists(FILENAME)) {
+        cout << "No saved tasks found." << endl;
+        return true;
+    }
+    size_t count = 0;
+    sortTaskLines({FILENAME}, field, memory, [&](const SortRecord& record) {
+        printTask(parseTaskLine(record.line), record.number);
+        ++count;
+        return output.good();
+    });
+    if (count == 0) cout << "No tasks available." << endl;
+    return true;
+}
+
+/**
+ * @brief Returns the ID stored in a line of a task file.
+ * @param line The line.
+ * @return The ID, or 0 if the line has none.
+ */
+unsigned lineId(const string& line) {
+    string id = sortKeyOf(line, "id");
+    return id == "~" ? 0 : static_cast<unsigned>(strtoul(id.c_str(), nullptr, 10));
+}
+
+/**
+ * @brief Merges task files into one sequence without duplicates.
+ *
+ * IDs are only unique within a file, so two lists started separately both have
+ * a task 1. The files are therefore first streamed in ID order with
+ * sortTaskLines(), under the same memory budget, to plan the merge: a line is
+ * a duplicate if an earlier file has a line with the same ID and the same
+ * normalized description, and is skipped; a line whose ID an earlier file
+ * uses for another task is renumbered to its ID plus the file index times the
+ * highest ID of all files. The plan keeps two bits per ID and file, not the
+ * lines or their keys. The files are then streamed again in merge order, and
+ * the IDs, parents and dependencies of renumbered tasks are rewritten in the
+ * lines of the same file. Lines without an ID are always passed on.
+ * @param paths The task files.
+ * @param field The merge order: `id`, `description`, `priority`, `due` or `created`.
+ * @param memory The memory budget in megabytes.
+ * @param emit Receives the lines of the merged sequence and returns false to stop.
+ * @param duplicates Receives the number of lines skipped as duplicates.
+ * @return false if a file cannot be opened.
+ */
+bool mergeTaskLines(const vector<string>& paths, const string& field, size_t memory,
+                    const function<bool(const string&)>& emit, size_t& duplicates) {
+    vector<vector<bool>> duplicate(paths.size()), renumbered(paths.size());
+    auto mark = [](vector<bool>& bits, unsigned id) {
+        if (bits.size() <= id) bits.resize(id + 1);
+        bits[id] = true;
+    };
+    auto marked = [](const vector<bool>& bits, unsigned id) { return id < bits.size() && bits[id]; };
+    unsigned group = 0, highest = 0;
+    uint32_t owner = 0;                 // the file of the first line with the ID
+    vector<string> descriptions;        // the tasks of the current ID
+    bool planned = sortTaskLines(paths, "id", memory, [&](const SortRecord& record) {
+        unsigned id = lineId(record.line);
+        if (id == 0) return true;
+        string description = normalizeDescription(parseTaskLine(record.line).description);
+        if (id != group) {
+            group = highest = id;
+            owner = record.file;
+            descriptions.assign(1, description);
+        } else if (record.file != owner) {  // an ID used twice in one file is left as it is
+            if (find(descriptions.begin(), descriptions.end(), description) != descriptions.end()) {
+                mark(duplicate[record.file], id);
+            } else {
+                mark(renumbered[record.file], id);
+                descriptions.push_back(description);
+            }
+        }
+        return true;
+    });
+    if (!planned) return false;
+
+    size_t plan = 0;
+    for (size_t i = 0; i < paths.size(); ++i) plan += (duplicate[i].size() + renumbered[i].size()) / 8;
+    memory = max<size_t>(1, memory - min(memory, plan >> 20));
+    duplicates = 0;
+    return sortTaskLines(paths, field, memory, [&](const SortRecord& record) {
+        unsigned id = lineId(record.line);
+        const vector<bool>& moved = renumbered[record.file];
+        if (id != 0 && marked(duplicate[record.file], id)) {
+            ++duplicates;
+            return true;
+        }
+        if (moved.empty()) return emit(record.line);
+        Task task = parseTaskLine(record.line);
+        bool changed = false;
+        auto renumber = [&](unsigned& reference) {
+            if (!marked(moved, reference)) return;
+            reference += record.file * highest;
+            changed = true;
+        };
+        renumber(task.id);
+        renumber(task.parent);
+        for (unsigned& after : task.after) renumber(after);
+        for (unsigned& blocks : task.blocks) renumber(blocks);
+        if (!changed) return emit(record.line);
+        ostringstream line;
+        writeTaskLine(line, task);
+        string text = line.str();
+        text.pop_back();  // the newline
+        return emit(text);
+    });
+}
+
+/**
+ * @brief Merges task files into a new task file.
+ *
+ * The output is written to a temporary file that replaces the output file only
+ * when complete, so an input may also be the output.
+ * @param paths The task files.
+ * @param field The merge order: `id`, `description`, `priority`, `due` or `created`.
+ * @param out The output file.
+ * @param memory The memory budget in megabytes.
+ * @return false if the merge failed.
+ */
+bool mergeTaskFiles(const vector<string>& paths, const string& field, const string& out, size_t memory) {
+    if (!isSortField(field)) return false;
+    string temp = out + ".tmp";
+    ofstream file(temp, ios::binary);
+    if (!file.is_open()) {
+        cout << "Cannot write '" << out << "'." << endl;
+        return false;
+    }
+    size_t written = 0, duplicates = 0;
+    bool merged = mergeTaskLines(paths, field, memory, [&](const string& line) {
+        file << line << '\n';
+        ++written;
+        return static_cast<bool>(file);
+    }, duplicates);
+    file.close();
+    error_code ec;
+    if (!merged || !file) {
+        if (merged) cout << "Cannot write '" << out << "'." << endl;
+        filesystem::remove(temp, ec);
+        return false;
+    }
+    filesystem::rename(temp, out, ec);
+    if (ec) {
+        cout << "Cannot write '" << out << "': " << ec.message() << endl;
+        filesystem::remove(temp, ec);
+        return false;
+    }
+    cout << "Merged " << written << " tasks from " << paths.size() << " files into " << out
+         << " (" << duplicates << " duplicates skipped)." << endl;
+    return true;
+}
+
+/**
+ * @brief Lists several task files as one merged list, without changing them.
+ *
+ * Tasks are numbered by their position in the merged list.
+ * @param paths The task files.
+ * @param field The merge order: `id`, `description`, `priority`, `due` or `created`.
+ * @param memory The memory budget in megabytes.
+ * @return false if the field is unknown or a file cannot be opened.
+ */
+bool listMerged(const vector<string>& paths, const string& field, size_t memory) {
+    if (!isSortField(field)) return false;
+    size_t count = 0, duplicates = 0;
+    bool merged = mergeTaskLines(paths, field, memory, [&](const string& line) {
+        printTask(parseTaskLine(line), ++count);
+        return output.good();
+    }, duplicates);
+    if (merged && count == 0) cout << "No tasks available." << endl;
+    return merged;
+}
+
+std::string EVENTS_FILENAME = getExecutableDirectory() + "\\todo.events"; /**< File path of the change event journal */
+
+/**
+ * @struct ChangeEvent
+ * @brief A change waiting to be appended to the event journal.
+ */
+struct ChangeEvent {
+    string event;           /**< `add`, `done`, `reschedule`, `remove`, `reset`, `import` or `batch`. */
+    unsigned id = 0;        /**< The ID of the task concerned, or 0. */
+    string description;     /**< The description of the task concerned. */
+    long long count = 0;    /**< The number of tasks imported, or of events in a batch. */
+};
+
+vector<ChangeEvent> pendingEvents; /**< Events recorded since the last save, written by appendEvents(). */
+
+/**
+ * @brief Returns the sequence number of the event journal line at an offset.
+ * @param journal The open journal.
+ * @param offset The offset of the start of a line.
+ * @return The sequence number, or 0 if the line has none.
+ */
+unsigned long long eventSequence(FILE* journal, long long offset) {
+    char head[32] = {};
+    if (_fseeki64(journal, offset, SEEK_SET) != 0) return 0;
+    size_t got = fread(head, 1, sizeof(head) - 1, journal);
+    head[got] = '\0';
+    return strncmp(head, "{\"seq\":", 7) == 0 ? strtoull(head + 7, nullptr, 10) : 0;
+}
+
+/**
+ * @brief Returns the first line start at or after an offset of the event journal.
+ * @param journal The open journal.
+ * @param offset The offset.
+ * @param size The size of the journal.
+ * @return The offset of the line start, or size if there is none.
+ */
+long long eventLineStart(FILE* journal, long long offset, long long size) {
+    if (offset <= 0) return 0;
+    if (_fseeki64(journal, offset - 1, SEEK_SET) != 0) return size;
+    for (int c; (c = fgetc(journal)) != EOF; ++offset) {
+        if (c == '\n') return offset;
+    }
+    return size;
+}
+
+/**
+ * @brief Finds the last line break of the event journal before an offset.
+ * @param journal The open journal.
+ * @param end The offset to search back from.
+ * @return The offset of the line break, or -1 if there is none.
+ */
+long long lastEventBreak(FILE* journal, long long end) {
+    char block[4096];
+    while (end > 0) {
+        long long begin = max(0LL, end - static_cast<long long>(sizeof(block)));
+        if (_fseeki64(journal, begin, SEEK_SET) != 0) return -1;
+        size_t got = fread(block, 1, static_cast<size_t>(end - begin), journal);
+        for (size_t i = got; i > 0; --i) {
+            if (block[i - 1] == '\n') return begin + static_cast<long long>(i) - 1;
+        }
+        end = begin;
+    }
+    return -1;
+}
+
+/**
+ * @brief Appends the pending events to the event journal.
+ *
+ * Every event becomes one JSON line with a sequence number one higher than the
+ * last line of the journal, the time and the task concerned. The events are
+ * appended with a single write, so readers see a batch as one group. Called
+ * after the task file was written, so the journal never runs ahead of the list.
+ * A last line without a line break was torn by an interrupted write; it is
+ * cut off, and the numbering continues from the last complete line.
+ * @param durable If true, the journal is flushed to disk before returning.
+ */
+void appendEvents(bool durable = false) {
+    if (pendingEvents.empty()) return;
+    FILE* journal = fopen(EVENTS_FILENAME.c_str(), "ab+");
+    if (!journal) return;
+    _fseeki64(journal, 0, SEEK_END);
+    long long size = _ftelli64(journal);
+    long long last = lastEventBreak(journal, size);
+    if (last != size - 1) {  // readers copy complete lines only, so none has seen the torn one
+        fclose(journal);
+        error_code ec;
+        filesystem::resize_file(EVENTS_FILENAME, static_cast<uintmax_t>(last + 1), ec);
+        journal = fopen(EVENTS_FILENAME.c_str(), "ab+");
+        if (ec || !journal) {
+            if (journal) fclose(journal);
+            return;
+        }
+    }
+    unsigned long long seq = last < 0 ? 0 : eventSequence(journal, lastEventBreak(journal, last) + 1);
+    _fseeki64(journal, 0, SEEK_END);
+    size_t capacity = 0;  // enough for the whole group, so it is flushed once
+    for (const ChangeEvent& event : pendingEvents) capacity += 128 + 6 * event.description.size();
+    {
+        OutputBuffer out(journal, capacity);
+        long long now = static_cast<long long>(time(nullptr));
+        for (const ChangeEvent& event : pendingEvents) {
+            string head = "{\"seq\":" + to_string(++seq) + ",\"time\":" + to_string(now) + ",\"event\":\"" + event.event + "\"";
+            if (event.id != 0) head += ",\"id\":" + to_string(event.id) + ",\"description\":";
+            out.write(head);
+            if (event.id != 0) writeJsonString(event.description.data(), event.description.size(), out);
+            if (event.count > 0) out.write(",\"count\":" + to_string(event.count));
+            out.write("}\n");
+        }
+    }
+    fclose(journal);
+    if (durable) flushToDisk(EVENTS_FILENAME);
+    pendingEvents.clear();
+}
+
+void recordImport(long long count) {
+    pendingEvents.push_back({"import", 0, "", count});
+    appendEvents();
+}
+
+/**
+ * @brief Prints the event journal from a position, optionally following it.
+ *
+ * The journal lines are copied as they are, so a consumer that started at
+ * offset X knows the offset of every following event by counting bytes. A
+ * sequence number is located by binary search over the line starts. When
+ * following, new events are printed as soon as change notifications report
+ * that the journal grew, until the reader of the output goes away.
+ * @param from The first sequence number to print, or 0.
+ * @param offset The byte offset to start at, used if from is 0.
+ * @param follow Whether to keep waiting for new events.
+ * @return false if the journal cannot be read.
+ */
+bool printEvents(unsigned long long from, long long offset, bool follow) {
+    FILE* journal = fopen(EVENTS_FILENAME.c_str(), "rb");
+    if (!journal && !follow) {
+        cout << "No events recorded." << endl;
+        return true;
+    }
+    long long size = 0;
+    if (journal) {
+        _fseeki64(journal, 0, SEEK_END);
+        size = _ftelli64(journal);
+        if (from > 0) {
+            long long low = 0, high = size;
+            while (low < high) {  // the first position whose next line has a sequence number >= from
+                long long middle = low + (high - low) / 2;
+                long long line = eventLineStart(journal, middle, size);
+                if (line >= size || eventSequence(journal, line) >= from) high = middle;
+                else low = middle + 1;
+            }
+            offset = eventLineStart(journal, low, size);
+        } else {
+            offset = eventLineStart(journal, min(offset, size), size);
+        }
+    }
+
+    HANDLE change = follow ? FindFirstChangeNotificationA(getExecutableDirectory().c_str(), FALSE,
+                                                          FILE_NOTIFY_CHANGE_SIZE | FILE_NOTIFY_CHANGE_LAST_WRITE)
+                           : INVALID_HANDLE_VALUE;
+    vector<char> chunk(IMPORT_CHUNK);
+    while (output.good()) {
+        if (!journal) journal = fopen(EVENTS_FILENAME.c_str(), "rb");
+        if (journal) {
+            _fseeki64(journal, 0, SEEK_END);
+            size = _ftelli64(journal);
+            while (offset < size) {
+                _fseeki64(journal, offset, SEEK_SET);
+                size_t got = fread(chunk.data(), 1, static_cast<size_t>(min<long long>(size - offset, chunk.size())), journal);
+                size_t complete = got;
+                while (complete > 0 && chunk[complete - 1] != '\n') --complete;
+                if (complete == 0) {
+                    if (got < chunk.size()) break;  // an event still being written
+                    chunk.resize(chunk.size() * 2);
+                    continue;
+                }
+                output.write(chunk.data(), complete);
+                offset += static_cast<long long>(complete);
+            }
+            output.flush();
+        }
+        if (!follow || change == INVALID_HANDLE_VALUE) break;
+        if (WaitForSingleObject(change, 1000) == WAIT_OBJECT_0) FindNextChangeNotification(change);
+    }
+    if (change != INVALID_HANDLE_VALUE) FindCloseChangeNotification(change);
+    if (journal) fclose(journal);
+    return follow ? change != INVALID_HANDLE_VALUE : true;
+}
+
+void recordChange(Change change, const Task& task) {
+    static const char* names[] = {"add", "done", "reschedule", "remove"};
+    pendingEvents.push_back({names[static_cast<int>(change)], task.id, task.description});
+    updateViews(change, task);
+    advanceGenerations(change);
+    updateStats(change, task);
+    updateHashIndex(change, task);
+    updateCompletions(change, task);
+    updateTrigramIndex(change, task);
+}
+
+void recordReset() {
+    pendingEvents.push_back({"reset", 0, "", 0});
+    for (SavedView& view : savedViews) {
+        viewsChanged = viewsChanged || !view.rows.empty();
+        view.rows.clear();
+    }
+    advanceGenerations(Change::Removed);
+    loadStats();
+    taskStats.total = taskStats.done = 0;
+    taskStats.tags.clear();
+    loadHashIndex();
+    rebuildHashIndex({});
+    loadCompletions();
+    rebuildCompletions({});
+    trigramIndex = TrigramIndex();
+}
+
+std::string OFFSETS_FILENAME = getExecutableDirectory() + "\\todo.offsets"; /**< File path of the line offset index */
+
+const uint32_t OFFSETS_MAGIC = 0x314F5854;  /**< Identifies a line offset index file ("TXO1"). */
+const size_t OFFSET_STRIDE = 64;            /**< The number of lines between two checkpoints of the offset index. */
+
+/**
+ * @struct OffsetIndex
+ * @brief The byte offsets of every OFFSET_STRIDE-th line of the task file.
+ *
+ * Any line is found by seeking to the checkpoint before it and skipping at most
+ * OFFSET_STRIDE - 1 lines, so a page of the list can be read without reading
+ * the lines before it.
+ */
+struct OffsetIndex {
+    uint64_t lines = 0;              /**< The number of lines in the task file. */
+    vector<uint64_t> checkpoints;    /**< The offset of line k * OFFSET_STRIDE, for every k. */
+};
+
+/**
+ * @brief Loads the offset index of the task file, building it if needed.
+ *
+ * The index file is only trusted if the task file has not changed since it was
+ * written; otherwise the task file is scanned once and the index saved.
+ * @param index Receives the index.
+ * @return false if the task file cannot be read.
+ */
+bool loadOffsetIndex(OffsetIndex& index) {
+    string stamp = taskFileStamp();
+    if (stamp.empty()) return false;
+    ifstream saved(OFFSETS_FILENAME, ios::binary);
+    uint32_t header[2];
+    if (saved.read(reinterpret_cast<char*>(header), sizeof(header)) && header[0] == OFFSETS_MAGIC && header[1] <= 64) {
+        string savedStamp(header[1], '\0');
+        uint64_t count = 0;
+        saved.read(&savedStamp[0], header[1]);
+        saved.read(reinterpret_cast<char*>(&index.lines), sizeof(index.lines));
+        saved.read(reinterpret_cast<char*>(&count), sizeof(count));
+        if (saved && savedStamp == stamp && count == (index.lines + OFFSET_STRIDE - 1) / OFFSET_STRIDE) {
+            index.checkpoints.resize(count);
+            if (saved.read(reinterpret_cast<char*>(index.checkpoints.data()), static_cast<streamsize>(count * 8))) return true;
+        }
+    }
+    saved.close();
+
+    ifstream in(FILENAME, ios::binary);
+    if (!in.is_open()) return false;
+    index.lines = 0;
+    index.checkpoints.clear();
+    vector<char> chunk(IMPORT_CHUNK);
+    uint64_t offset = 0;
+    bool lineStart = true;
+    while (in.read(chunk.data(), static_cast<streamsize>(chunk.size())) || in.gcount() > 0) {
+        size_t got = static_cast<size_t>(in.gcount());
+        for (size_t i = 0; i < got;) {
+            if (lineStart) {
+                if (index.lines % OFFSET_STRIDE == 0) index.checkpoints.push_back(offset + i);
+                ++index.lines;
+                lineStart = false;
+            }
+            const void* newline = memchr(chunk.data() + i, '\n', got - i);
+            if (!newline) break;
+            i = static_cast<const char*>(newline) - chunk.data() + 1;
+            lineStart = true;
+        }
+        offset += got;
+    }
+    ofstream file(OFFSETS_FILENAME, ios::binary);
+    uint32_t head[2] = {OFFSETS_MAGIC, static_cast<uint32_t>(stamp.size())};
+    uint64_t count = index.checkpoints.size();
+    file.write(reinterpret_cast<const char*>(head), sizeof(head));
+    file.write(stamp.data(), static_cast<streamsize>(stamp.size()));
+    file.write(reinterpret_cast<const char*>(&index.lines), sizeof(index.lines));
+    file.write(reinterpret_cast<const char*>(&count), sizeof(count));
+    file.write(reinterpret_cast<const char*>(index.checkpoints.data()), static_cast<streamsize>(count * 8));
+    return true;
+}
+
+/**
+ * @brief Reads consecutive lines of the task file through the offset index.
+ * @param in The open task file.
+ * @param index The offset index.
+ * @param first The 0-based number of the first line.
+ * @param count The number of lines to read.
+ * @return The lines; fewer at the end of the file.
+ */
+vector<string> fetchLines(ifstream& in, const OffsetIndex& index, uint64_t first, size_t count) {
+    vector<string> lines;
+    if (first >= index.lines) return lines;
+    in.clear();
+    in.seekg(static_cast<streamoff>(index.checkpoints[first / OFFSET_STRIDE]));
+    string line;
+    for (uint64_t skip = first % OFFSET_STRIDE; skip > 0 && getline(in, line); --skip) {}
+    while (lines.size() < count && getline(in, line)) {
+        if (!line.empty() && line.back() == '\r') line.pop_back();
+        lines.push_back(line);
+    }
+    return lines;
+}
+
+/**
+ * @brief Shows the list in a full-screen, scrollable view.
+ *
+ * Only the rows on screen are read, through the offset index, and formatted,
+ * so moving around costs the same on a list of any size. Keys: arrows or
+ * j/k move, PgUp/PgDn or b/space page, Home/End or g/G jump, q quits.
+ * @return false if the list is empty or no console is attached.
+ */
+bool runTui() {
+    HANDLE input = GetStdHandle(STD_INPUT_HANDLE);
+    HANDLE console = GetStdHandle(STD_OUTPUT_HANDLE);
+    DWORD inputMode, outputMode;
+    if (outputFormat != OutputFormat::Text || !GetConsoleMode(input, &inputMode) || !GetConsoleMode(console, &outputMode)) {
+        cout << "The full-screen view needs a console." << endl;
+        return false;
+    }
+    OffsetIndex index;
+    if (!loadOffsetIndex(index) || index.lines == 0) {
+        cout << "No tasks available." << endl;
+        return false;
+    }
+    ifstream in(FILENAME, ios::binary);
+    SetConsoleMode(console, outputMode | ENABLE_VIRTUAL_TERMINAL_PROCESSING);
+    fputs("\x1b[?1049h\x1b[?25l", stdout);  // alternate screen, hidden cursor
+
+    uint64_t top = 0, selected = 0;
+    while (true) {
+        CONSOLE_SCREEN_BUFFER_INFO info;
+        GetConsoleScreenBufferInfo(console, &info);
+        size_t width = max(20, info.srWindow.Right - info.srWindow.Left + 1);
+        size_t rows = max(2, info.srWindow.Bottom - info.srWindow.Top + 1) - 1;  // the last row is the status line
+        if (selected < top) top = selected;
+        if (selected >= top + rows) top = selected - rows + 1;
+
+        string frame = "\x1b[H";
+        vector<string> lines = fetchLines(in, index, top, rows);
+        for (size_t r = 0; r < rows; ++r) {
+            string text = r < lines.size() ? formatTask(parseTaskLine(lines[r]), top + r + 1) : "";
+            if (text.size() > width) text.resize(width);
+            frame += top + r == selected ? "\x1b[7m" + text + "\x1b[K\x1b[0m\r\n" : text + "\x1b[K\r\n";
+        }
+        string status = " " + to_string(selected + 1) + "/" + to_string(index.lines) + "  arrows/PgUp/PgDn/Home/End move, q quits";
+        if (status.size() > width) status.resize(width);
+        frame += "\x1b[7m" + status + "\x1b[K\x1b[0m";
+        fwrite(frame.data(), 1, frame.size(), stdout);
+        fflush(stdout);
+
+        int key = _getch();
+        if (key == 0 || key == 0xE0) {  // arrow and navigation keys arrive as two codes
+            switch (_getch()) {
+            case 'H': key = 'k'; break;
+            case 'P': key = 'j'; break;
+            case 'I': key = 'b'; break;
+            case 'Q': key = ' '; break;
+            case 'G': key = 'g'; break;
+            case 'O': key = 'G'; break;
+            default: key = 0;
+            }
+        }
+        uint64_t last = index.lines - 1;
+        if (key == 'q' || key == 27 || key == EOF) break;
+        if (key == 'k' && selected > 0) --selected;
+        if (key == 'j' && selected < last) ++selected;
+        if (key == 'b') selected = selected > rows ? selected - rows : 0;
+        if (key == ' ') selected = min(last, selected + rows);
+        if (key == 'g') selected = 0;
+        if (key == 'G') selected = last;
+    }
+    fputs("\x1b[?25h\x1b[?1049l", stdout);
+    fflush(stdout);
+    SetConsoleMode(console, outputMode);
+    return true;
+}
+
+const chrono::milliseconds EVENT_WAIT(1000); /**< How long `watch` waits for the events of a task file change. */
+
+/**
+ * @struct WatchState
+ * @brief What a watched list was built from.
+ */
+struct WatchState {
+    string stamp = "-";      /**< The stamp of the task file, see taskFileStamp(). */
+    uintmax_t size = 0;      /**< The size of the task file. */
+    long long events = 0;    /**< The offset in the event journal up to which events were read. */
+    bool waiting = false;    /**< Whether the task file changed and its events have not come yet. */
+    chrono::steady_clock::time_point changed; /**< When the unexplained change was seen. */
+};
+
+/**
+ * @brief Brings a watched task list up to date with the task file.
+ *
+ * The events saved since the last call are read from the event journal. If
+ * they are all additions at the end of the list, e.g. by `add` or `import`,
+ * only the bytes after the previous size of the task file are read, and the
+ * IDs of the new lines must match the events. After any other change, or a
+ * change without events such as an edit of the file, the list is loaded again.
+ * The events are appended after the task file is saved, so a change without
+ * events is only taken as an edit once no events came for EVENT_WAIT.
+ * @param tasks The watched list.
+ * @param state What the list was built from; updated.
+ * @return true if the task file changed.
+ */
+bool refreshWatched(vector<Task>& tasks, WatchState& state) {
+    // The new events: IDs of added tasks, 0 for each task of an import
+    vector<unsigned> added;
+    bool appendOnly = true;
+    if (FILE* journal = fopen(EVENTS_FILENAME.c_str(), "rb")) {
+        _fseeki64(journal, 0, SEEK_END);
+        long long size = _ftelli64(journal);
+        if (size < state.events) state.events = 0;  // the journal was replaced
+        _fseeki64(journal, state.events, SEEK_SET);
+        string line;
+        for (int c; (c = fgetc(journal)) != EOF;) {
+            if (c != '\n') {
+                line += static_cast<char>(c);
+                continue;
+            }
+            state.events += static_cast<long long>(line.size()) + 1;
+            size_t event = line.find("\"event\":\"");
+            string name = event == string::npos ? "" : line.substr(event + 9, line.find('"', event + 9) - event - 9);
+            size_t field = line.find(name == "add" ? "\"id\":" : "\"count\":");
+            long long value = field == string::npos ? 0 : atoll(line.c_str() + line.find(':', field) + 1);
+            if (name == "add") added.push_back(static_cast<unsigned>(value));
+            else if (name == "import") added.insert(added.end(), static_cast<size_t>(value), 0);
+            else if (name != "batch") appendOnly = false;
+            line.clear();
+        }
+        fclose(journal);
+    }
+
+    string stamp = taskFileStamp();
+    if (stamp == state.stamp) return false;  // the events were already seen in the file
+    if (added.empty() && appendOnly && state.stamp != "-") {  // not on the first load
+        auto now = chrono::steady_clock::now();
+        if (!state.waiting) {
+            state.waiting = true;
+            state.changed = now;
+        }
+        if (now - state.changed < EVENT_WAIT) return false;
+    }
+    state.waiting = false;
+    state.stamp = stamp;
+    error_code ec;
+    uintmax_t size = filesystem::file_size(FILENAME, ec);
+    if (ec) size = 0;
+
+    bool appended = appendOnly && !added.empty() && size > state.size;
+    if (appended) {
+        ifstream in(FILENAME, ios::binary);
+        in.seekg(static_cast<streamoff>(state.size));
+        vector<Task> lines;
+        for (string line; appended && getline(in, line);) {
+            if (!line.empty() && line.back() == '\r') line.pop_back();
+            if (line.empty()) continue;
+            lines.push_back(parseTaskLine(line));
+            const Task& task = lines.back();
+            size_t k = lines.size() - 1;
+            appended = k < added.size() && task.id != 0 && task.parent == 0 && (added[k] == 0 || added[k] == task.id);
+        }
+        if (appended && lines.size() == added.size()) move(lines.begin(), lines.end(), back_inserter(tasks));
+        else appended = false;
+    }
+    if (!appended) {
+        tasks.clear();
+        if (size > 0) loadTasksFromFile(tasks);
+    }
+    state.size = size;
+    return true;
+}
+
+/**
+ * @brief Shows the list and keeps it up to date as the task file changes.
+ *
+ * Waits for change notifications on the directory of the task file instead of
+ * polling it. On a change the list is refreshed with refreshWatched(), which
+ * follows the event journal to read only appended tasks when it can, and
+ * only the screen rows whose text changed since the previous frame are
+ * written again. `q` quits.
+ * @return false if no console is attached.
+ */
+bool runWatch() {
+    HANDLE console = GetStdHandle(STD_OUTPUT_HANDLE);
+    DWORD outputMode;
+    if (outputFormat != OutputFormat::Text || !GetConsoleMode(console, &outputMode)) {
+        cout << "Watching needs a console." << endl;
+        return false;
+    }
+    HANDLE change = FindFirstChangeNotificationA(getExecutableDirectory().c_str(), FALSE,
+        FILE_NOTIFY_CHANGE_FILE_NAME | FILE_NOTIFY_CHANGE_SIZE | FILE_NOTIFY_CHANGE_LAST_WRITE);
+    if (change == INVALID_HANDLE_VALUE) {
+        cout << "Cannot watch " << FILENAME << "." << endl;
+        return false;
+    }
+    SetConsoleMode(console, outputMode | ENABLE_VIRTUAL_TERMINAL_PROCESSING);
+    fputs("\x1b[2J", stdout);
+
+    vector<Task> tasks;
+    WatchState state;
+    if (FILE* journal = fopen(EVENTS_FILENAME.c_str(), "rb")) {  // earlier events are in the loaded list
+        _fseeki64(journal, 0, SEEK_END);
+        state.events = _ftelli64(journal);
+        fclose(journal);
+    }
+    string updated;
+    vector<string> previous;
+    while (true) {
+        if (refreshWatched(tasks, state)) {
+            time_t now = time(nullptr);
+            char clock[16];
+            strftime(clock, sizeof(clock), "%H:%M:%S", localtime(&now));
+            updated = clock;
+        }
+        CONSOLE_SCREEN_BUFFER_INFO info;
+        GetConsoleScreenBufferInfo(console, &info);
+        size_t width = max(20, info.srWindow.Right - info.srWindow.Left + 1);
+        size_t rows = max(2, info.srWindow.Bottom - info.srWindow.Top + 1) - 1;
+
+        vector<string> frame;
+        for (size_t i = 0; i < tasks.size() && frame.size() < rows; ++i) {
+            frame.push_back(string(2 * tasks[i].depth, ' ') + formatTask(tasks[i], i + 1));
+        }
+        if (tasks.empty()) frame.push_back("No tasks available.");
+        frame.resize(rows);
+        frame.push_back("Watching " + to_string(tasks.size()) + " tasks, updated " + updated + ". Press q to quit.");
+        string out;
+        for (size_t r = 0; r < frame.size(); ++r) {
+            if (frame[r].size() > width) frame[r].resize(width);
+            if (r < previous.size() && previous[r] == frame[r]) continue;
+            out += "\x1b[" + to_string(r + 1) + ";1H" + frame[r] + "\x1b[K";
+        }
+        if (frame.size() < previous.size()) out += "\x1b[" + to_string(frame.size() + 1) + ";1H\x1b[J";
+        if (!out.empty()) {
+            fwrite(out.data(), 1, out.size(), stdout);
+            fflush(stdout);
+        }
+        previous = move(frame);
+
+        if (WaitForSingleObject(change, 250) == WAIT_OBJECT_0) FindNextChangeNotification(change);
+        if (_kbhit() && tolower(_getch()) == 'q') break;
+    }
+    FindCloseChangeNotification(change);
+    fputs("\r\n", stdout);
+    SetConsoleMode(console, outputMode);
+    return true;
+}
+
+/**
+ * @brief Returns the common path of the files of a list, without extension.
+ * @param name The list name.
+ * @return The path; the task file is this path followed by `.txt`.
+ */
+string listBase(const string& name) {
+    return getExecutableDirectory() + (name == "default" ? "\\todo" : "\\todo-" + name);
+}
+
+/**
+ * @brief Tells whether a list name is valid.
+ * @param name The list name.
+ * @return true for 1 to 64 letters, digits, `-` and `_`.
+ */
+bool isListName(const string& name) {
+    return !name.empty() && name.size() <= 64 &&
+           name.find_first_not_of("ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789-_") == string::npos;
+}
+
+/**
+ * @brief Selects the list that all commands work on.
+ *
+ * The default list keeps the `todo.*` files; a named list uses `todo-NAME.*`
+ * files in the same directory, so only the selected list is ever read.
+ * @param name The list name: letters, digits, `-` and `_`.
+ * @return false if the name is not valid.
+ */
+bool selectList(const string& name) {
+    if (!isListName(name)) {
+        cout << "Invalid list name '" << name << "'. Use letters, digits, '-' and '_'." << endl;
+        return false;
+    }
+    listName = name;
+    string base = listBase(name);
+    FILENAME = base + ".txt";
+    CACHE_FILENAME = base + ".cache";
+    STATS_FILENAME = base + ".stats";
+    VIEWS_FILENAME = base + ".views";
+    TIMELOG_FILENAME = base + ".timelog";
+    TIMESUM_FILENAME = base + ".timesum";
+    HASH_FILENAME = base + ".hash";
+    COMPLETION_FILENAME = base + ".complete";
+    EVENTS_FILENAME = base + ".events";
+    IDS_FILENAME = base + ".ids";
+    OFFSETS_FILENAME = base + ".offsets";
+    return true;
+}
+
+/**
+ * @struct ListResult
+ * @brief The result of a job on one list, produced by a worker thread.
+ */
+struct ListResult {
+    size_t list = 0;                      /**< The position of the list in the catalog. */
+    bool found = false;                   /**< Whether the task file could be read. */
+    vector<pair<size_t, Task>> tasks;     /**< Matching tasks with their list numbers. */
+    long long total = 0;                  /**< The number of tasks. */
+    long long done = 0;                   /**< The number of completed tasks. */
+};
+
+/**
+ * @brief Runs a job on every list with a pool of worker threads.
+ *
+ * Workers take the next list whenever they become free. Finished results are
+ * handed to the calling thread in completion order, so output starts as soon
+ * as the first list is done, and only the calling thread writes output.
+ * @param count The number of lists.
+ * @param job Computes the result for the list at a position; runs on a worker thread.
+ * @param consume Receives every result on the calling thread.
+ */
+void forEachList(size_t count, const function<ListResult(size_t)>& job, const function<void(ListResult&)>& consume) {
+    size_t workers = min<size_t>(max<size_t>(1, thread::hardware_concurrency()), count);
+    atomic<size_t> next(0);
+    mutex lock;
+    condition_variable ready;
+    deque<ListResult> results;
+    vector<thread> threads;
+    for (size_t w = 0; w < workers; ++w) {
+        threads.emplace_back([&] {
+            for (size_t i = next++; i < count; i = next++) {
+                ListResult result = job(i);
+                result.list = i;
+                lock_guard<mutex> guard(lock);
+                results.push_back(move(result));
+                ready.notify_one();
+            }
+        });
+    }
+    for (size_t received = 0; received < count; ++received) {
+        unique_lock<mutex> guard(lock);
+        ready.wait(guard, [&] { return !results.empty(); });
+        ListResult result = move(results.front());
+        results.pop_front();
+        guard.unlock();
+        consume(result);
+    }
+    for (thread& t : threads) t.join();
+}
+
+/**
+ * @brief Returns the names of all lists.
+ *
+ * Lists whose counts were never saved have no catalog entry yet, so the task
+ * files in the executable directory are listed as well.
+ * @return The names in catalog order.
+ */
+vector<string> catalogNames() {
+    map<string, CatalogEntry> lists = loadCatalog();
+    error_code ec;
+    for (filesystem::directory_iterator it(getExecutableDirectory(), ec), end; !ec && it != end; it.increment(ec)) {
+        string file = it->path().filename().string();
+        if (file == "todo.txt") {
+            lists["default"];
+        } else if (file.size() > 9 && file.compare(0, 5, "todo-") == 0 && file.compare(file.size() - 4, 4, ".txt") == 0) {
+            string name = file.substr(5, file.size() - 9);
+            if (isListName(name)) lists[name];
+        }
+    }
+    vector<string> names;
+    for (const auto& list : lists) names.push_back(list.first);
+    if (names.empty()) cout << "No lists found." << endl;
+    return names;
+}
+
+/**
+ * @brief Streams the tasks of a list file without loading the list.
+ * @param name The list name.
+ * @param visit Receives every task with its list number.
+ * @return false if the task file cannot be opened.
+ */
+bool scanList(const string& name, const function<void(size_t, Task&&)>& visit) {
+    ifstream in(listBase(name) + ".txt", ios::binary);
+    if (!in.is_open()) return false;
+    RecordReader reader(in, false);
+    string_view line;
+    for (size_t number = 1; reader.next(line); ++number) {
+        visit(number, parseTaskLine(string(line)));
+    }
+    return true;
+}
+
+/**
+ * @brief Runs a query on every list in parallel.
+ *
+ * Each list is scanned by a worker thread. Without `order by` the matches are
+ * printed as each list completes. With `order by` every worker keeps only its
+ * best `limit` tasks in a bounded heap, and these are merged into a bounded
+ * heap of the same size, so memory stays proportional to the limit; ties keep
+ * catalog order. The result cache and indexes of the lists are not used.
+ * @param text The query text; empty to match every task.
+ * @return false if the query could not be parsed.
+ */
+bool queryAllLists(const string& text) {
+    Query query;
+    string error;
+    if (!text.empty() && !parseQuery(text, query, error)) {
+        cout << "Invalid query: " << error << endl;
+        return false;
+    }
+    vector<string> names = catalogNames();
+    if (names.empty()) return true;
+    struct Hit {
+        string key;
+        size_t list;
+        size_t number;
+        Task task;
+    };
+    // Unset values sort last in either direction, like runQuery()
+    auto before = [&](const Hit& a, const Hit& b) {
+        if (a.key.empty() != b.key.empty()) return b.key.empty();
+        if (a.key != b.key) return query.descending ? a.key > b.key : a.key < b.key;
+        return tie(a.list, a.number) < tie(b.list, b.number);
+    };
+    auto keep = [&](vector<Hit>& heap, Hit&& hit) {  // the worst kept hit is on top
+        if (query.limit == 0 || (heap.size() == query.limit && !before(hit, heap.front()))) return;
+        heap.push_back(move(hit));
+        push_heap(heap.begin(), heap.end(), before);
+        if (heap.size() > query.limit) {
+            pop_heap(heap.begin(), heap.end(), before);
+            heap.pop_back();
+        }
+    };
+    vector<Hit> best;
+    size_t printed = 0;
+    forEachList(names.size(), [&](size_t i) {
+        ListResult result;
+        vector<Hit> heap;
+        result.found = scanList(names[i], [&](size_t number, Task&& task) {
+            if (query.where && !matchesQuery(*query.where, task)) return;
+            if (query.ordered) keep(heap, {sortKey(task, query.orderBy), i, number, move(task)});
+            else if (result.tasks.size() < query.limit) result.tasks.push_back({number, move(task)});
+        });
+        for (Hit& hit : heap) result.tasks.push_back({hit.number, move(hit.task)});
+        return result;
+    }, [&](ListResult& result) {
+        for (auto& entry : result.tasks) {
+            if (query.ordered) {
+                keep(best, {sortKey(entry.second, query.orderBy), result.list, entry.first, move(entry.second)});
+            } else if (printed < query.limit) {
+                printTask(entry.second, entry.first, 0, "", names[result.list]);
+                ++printed;
+            }
+        }
+    });
+    sort_heap(best.begin(), best.end(), before);
+    for (const Hit& hit : best) {
+        printTask(hit.task, hit.number, 0, "", names[hit.list]);
+        ++printed;
+    }
+    if (printed == 0) cout << "No matching tasks." << endl;
+    return true;
+}
+
+/**
+ * @brief Counts the tasks of every list in parallel.
+ *
+ * Unlike `lists`, which shows the catalog, this reads every task file; the
+ * counts of each list are printed as soon as it is done, followed by the totals.
+ */
+void statsAllLists() {
+    vector<string> names = catalogNames();
+    if (names.empty()) return;
+    long long total = 0, done = 0;
+    forEachList(names.size(), [&](size_t i) {
+        ListResult result;
+        ifstream in(listBase(names[i]) + ".txt", ios::binary);
+        result.found = in.is_open();
+        RecordReader reader(in, false);
+        string_view line;
+        while (result.found && reader.next(line)) {
+            if (line.empty()) continue;
+            ++result.total;
+            if (line[0] == '1') ++result.done;
+        }
+        return result;
+    }, [&](ListResult& result) {
+        total += result.total;
+        done += result.done;
+        const string& name = names[result.list];
+        if (outputFormat != OutputFormat::Text) {
+            JsonRecord().field("list", name).field("tasks", result.total).field("open", result.total - result.done).field("done", result.done);
+        } else if (!result.found) {
+            cout << name << ": no task file" << endl;
+        } else {
+            cout << name << ": " << result.total << " tasks (" << result.total - result.done << " open, " << result.done << " done)" << endl;
+        }
+    });
+    if (outputFormat != OutputFormat::Text) {
+        JsonRecord().field("list", string("all")).field("tasks", total).field("open", total - done).field("done", done);
+    } else {
+        cout << "All lists: " << total << " tasks (" << total - done << " open, " << done << " done)" << endl;
+    }
+}
+
+void prepareSidecars() {
+    loadCache();
+    loadStats();
+    loadHashIndex();
+    loadCompletions();
+}
+
+void saveSidecars(const vector<Task>& tasks, bool durable) {
+    if (viewsChanged) saveViews();
+    saveLastTaskId();
+    saveTimeLog();
+    if (!taskStats.valid) rebuildStats(tasks);
+    saveStats();
+    saveCache();
+    if (!hashIndex.valid) rebuildHashIndex(tasks);
+    saveHashIndex();
+    if (!completionIndex.valid) rebuildCompletions(tasks);
+    saveCompletions();
+    appendEvents(durable);
+}
+
+/**
+ * @brief Runs a command that works on the list files rather than the loaded list.
+ *
+ * These commands read the task file as a stream, or only the files kept
+ * alongside it, so the list is never loaded.
+ * @param args The command line without the output and list options.
+ * @return The exit status, or -1 if the command needs the loaded task list.
+ */
+int runFileCommand(vector<string>& args) {
+    int argc = static_cast<int>(args.size());
+
+    // The full-screen view reads only the rows on screen
+    if (argc == 2 && args[1] == "tui") {
+        return runTui() ? 0 : 1;
+    }
+
+    // Events are read from their journal
+    if (argc >= 2 && args[1] == "events") {
+        unsigned long long from = 0;
+        long long offset = 0;
+        bool follow = false;
+        for (int i = 2; i < argc; ++i) {
+            if (args[i] == "--follow") {
+                follow = true;
+            } else if (args[i] == "--from" && i + 1 < argc) {
+                from = strtoull(args[++i].c_str(), nullptr, 10);
+            } else if (args[i] == "--offset" && i + 1 < argc) {
+                offset = atoll(args[++i].c_str());
+            } else {
+                cout << "Usage: todo events [--from SEQ | --offset BYTES] [--follow]" << endl;
+                return 1;
+            }
+        }
+        return printEvents(from, offset, follow) ? 0 : 1;
+    }
+
+    // Watching reloads the task file by itself as it changes
+    if (argc == 2 && args[1] == "watch") {
+        return runWatch() ? 0 : 1;
+    }
+
+    // The summary of all lists comes from the catalog alone
+    if (argc == 2 && args[1] == "lists") {
+        printLists();
+        return 0;
+    }
+
+    // Cross-list commands scan every list file in parallel
+    auto allLists = find(args.begin(), args.end(), "--all-lists");
+    if (argc >= 2 && allLists != args.end()) {
+        args.erase(allLists);
+        string command = args[1], text;
+        for (size_t i = 2; i < args.size(); ++i) text += (i > 2 ? " " : "") + args[i];
+        if (command == "stats" && text.empty()) {
+            statsAllLists();
+        } else if (command == "list" && text.empty()) {
+            queryAllLists("");
+        } else if ((command == "query" || command == "search") && !text.empty()) {
+            return queryAllLists(command == "search" ? searchQuery(text) : text) ? 0 : 1;
+        } else {
+            cout << "--all-lists works with list, stats, query and search." << endl;
+            return 1;
+        }
+        return 0;
+    }
+
+    // Statistics are answered without reading the task file
+    if (argc == 2 && args[1] == "stats") {
+        printStats();
+        return 0;
+    }
+
+    // Completions are looked up in their index file without reading the task file
+    if (argc >= 2 && args[1] == "complete") {
+        string prefix;
+        for (int i = 2; i < argc; ++i) prefix += (i > 2 ? " " : "") + args[i];
+        completeTasks(prefix);
+        return 0;
+    }
+
+    // Exports read the task file line by line without loading it
+    if (argc >= 2 && args[1] == "export") {
+        string format = "csv", fields, path;
+        for (int i = 2; i + 1 < argc; i += 2) {
+            if (args[i] == "--format") {
+                format = args[i + 1];
+            } else if (args[i] == "--fields") {
+                fields = args[i + 1];
+            } else if (args[i] == "--out") {
+                path = args[i + 1];
+            } else {
+                cout << "Usage: todo export [--format csv|ndjson] [--fields FIELD,...] [--out FILE]" << endl;
+                return 1;
+            }
+        }
+        if (argc % 2 != 0) {
+            cout << "Usage: todo export [--format csv|ndjson] [--fields FIELD,...] [--out FILE]" << endl;
+            return 1;
+        }
+        return exportTasks(format, fields, path) ? 0 : 1;
+    }
+
+    // Sorted and merged listings stream the task files, so they may be larger than memory
+    if (argc >= 4 && args[1] == "list" && (args[2] == "--sort" || args[2] == "--files")) {
+        string field, files;
+        size_t memory = SORT_MEMORY;
+        bool valid = argc % 2 == 0;
+        for (int i = 2; valid && i + 1 < argc; i += 2) {
+            if (args[i] == "--sort") field = args[i + 1];
+            else if (args[i] == "--files") files = args[i + 1];
+            else if (args[i] == "--memory" && atoi(args[i + 1].c_str()) > 0) memory = static_cast<size_t>(atoi(args[i + 1].c_str()));
+            else valid = false;
+        }
+        if (!valid) {
+            cout << "Usage: todo list [--sort id|description|priority|due|created] [--files FILE,...] [--memory MB]" << endl;
+            return 1;
+        }
+        if (files.empty()) return listSorted(field, memory) ? 0 : 1;
+        vector<string> paths;
+        stringstream list(files);
+        for (string path; getline(list, path, ',');) {
+            if (!path.empty()) paths.push_back(path);
+        }
+        return listMerged(paths, field.empty() ? "id" : field, memory) ? 0 : 1;
+    }
+
+    // Merges stream their inputs into the output file
+    if (argc >= 2 && args[1] == "merge") {
+        string field = "id", out;
+        size_t memory = SORT_MEMORY;
+        vector<string> paths;
+        bool valid = true;
+        for (int i = 2; i < argc; ++i) {
+            bool option = args[i] == "--by" || args[i] == "--out" || args[i] == "--memory";
+            if (option && i + 1 == argc) valid = false;
+            else if (args[i] == "--by") field = args[++i];
+            else if (args[i] == "--out") out = args[++i];
+            else if (args[i] == "--memory") memory = static_cast<size_t>(max(1, atoi(args[++i].c_str())));
+            else paths.push_back(args[i]);
+        }
+        if (!valid || out.empty() || paths.empty()) {
+            cout << "Usage: todo merge [--by id|description|priority|due|created] [--memory MB] --out FILE FILE..." << endl;
+            return 1;
+        }
+        return mergeTaskFiles(paths, field, out, memory) ? 0 : 1;
+    }
+
+    // Duplicates are rejected from the hash index without reading the task file
+    if (argc > 3 && args[1] == "add" && find(args.begin() + 2, args.end(), "--unique") != args.end()) {
+        string text;
+        for (int i = 2; i < argc; ++i) {
+            if (args[i] != "--unique") text += (text.empty() ? "" : " ") + args[i];
+        }
+        Task entry("");
+        parseTaskText(text, entry);
+        if (probeHashFile(entry.description) == 1) {
+            cout << "Task already exists: " << entry.description << endl;
+            return 0;
+        }
+    }
+
+    // Imports append to the task file without loading it
+    if (argc == 3 && args[1] == "import") {
+        loadViews();
+        return importTasks(args[2]) ? 0 : 1;
+    }
+
+    return -1;
+}
+
+/**
+ * @brief Tells whether runFileCommand() handles a command.
+ * @param args The command line without the output and list options.
+ * @return true for commands that read the list files directly.
+ */
+bool isFileCommand(const vector<string>& args) {
+    if (args.size() < 2) return false;
+    const string& command = args[1];
+    return command == "lists" || command == "stats" || command == "complete" || command == "export" ||
+           command == "merge" || command == "import" || command == "tui" || command == "watch" || command == "events" || find(args.begin(), args.end(), "--all-lists") != args.end() ||
+           (command == "list" && args.size() >= 4 && (args[2] == "--sort" || args[2] == "--files"));
+}
+
+/**
+ * @brief Runs a command on the loaded task list.
+ * @param tasks The task list.
+ * @param args The command line without the output and list options.
+ * @return The exit status.
+ */
+int runCommand(vector<Task>& tasks, const vector<string>& args) {
+    int argc = static_cast<int>(args.size());
+    string command = args[1];
+    string task;
+    bool explain = false;
+    bool bench = false;
+    bool unique = false;
+    bool exact = false;
+
+    for (int i = 2; i < argc; ++i) {
+        if (args[i] == "--explain" && (command == "query" || command == "search")) {
+            explain = true;
+            continue;
+        }
+        if (args[i] == "--bench" && (command == "query" || command == "search")) {
+            bench = true;
+            continue;
+        }
+        if (args[i] == "--unique" && command == "add") {
+            unique = true;
+            continue;
+        }
+        if (args[i] == "--exact" && command == "done") {
+            exact = true;
+            continue;
+        }
+        if (!task.empty()) task += " ";
+        task += args[i];
+    }
+
+    if (command == "list") {
+        int index = 0;
+        if (!task.empty() && !parseTaskNumber(task, index)) {
+            cout << "Usage: todo list [N | --sort FIELD | --files FILE,...]" << endl;
+            return 1;
+        }
+        listTasks(tasks, index);
+    } else if (command == "add" && !task.empty()) {
+        if (unique) {
+            Task entry("");
+            parseTaskText(task, entry);
+            if (findExactTask(tasks, entry.description) > 0) {
+                cout << "Task already exists: " << entry.description << endl;
+                return 0;
+            }
+        }
+        addTask(tasks, task);
+        saveTasks(tasks);
+        listTasks(tasks);
+    } else if (command == "subtask" && argc > 3) {
+        stringstream words(task);
+        int index = -1;
+        string description;
+        words >> index;
+        getline(words, description);
+        if (index < 0 || index > static_cast<int>(tasks.size())) {
+            cout << "Invalid task index." << endl;
+            return 1;
+        }
+        addTask(tasks, trim(description), index);
+        saveTasks(tasks);
+        listTasks(tasks, index);
+    } else if (command == "remove" && argc > 2) {
+        int index = resolveTask(tasks, task, false, true);
+        if (index < 0) return 1;
+        if (index == 0 || index > static_cast<int>(tasks.size())) {
+            cout << "Invalid task index." << endl;
+            return 1;
+        }
+        removeTask(tasks, index);
+        saveTasks(tasks);
+        listTasks(tasks);
+    } else if (command == "done" && !task.empty()) {
+        int index = exact ? findExactTask(tasks, task) : resolveTask(tasks, task, true);
+        if (exact && index == 0) {
+            cout << "No open task named '" << task << "'." << endl;
+            return 1;
+        }
+        if (index < 0) return 1;
+        if (index == 0 || index > static_cast<int>(tasks.size())) {
+            cout << "Invalid task index." << endl;
+            return 1;
+        }
+        markDone(tasks, index);
+        saveTasks(tasks);
+        listTasks(tasks);
+    } else if ((command == "block" || command == "unblock") && argc > 3) {
+        int index = resolveTask(tasks, args[2], false);
+        int prerequisite = index < 0 ? -1 : resolveTask(tasks, args[3], false);
+        if (prerequisite < 0) return 1;
+        bool linked = command == "block" ? addDependency(tasks, index, prerequisite)
+                                         : removeDependency(tasks, index, prerequisite);
+        if (!linked) return 1;
+        saveTasks(tasks);
+        listTasks(tasks);
+    } else if ((command == "start" || command == "stop") && argc > 2) {
+        int index = resolveTask(tasks, task, command == "start");
+        if (index < 0) return 1;
+        if (!(command == "start" ? startTimer(tasks, index) : stopTimer(tasks, index))) return 1;
+        saveTasks(tasks);
+    } else if (command == "time") {
+        string from = argc > 2 ? args[2] : "";
+        string to = argc > 3 ? args[3] : from;
+        if ((!from.empty() && !isDate(from)) || (!to.empty() && !isDate(to))) {
+            cout << "Dates must be in YYYY-MM-DD format." << endl;
+            return 1;
+        }
+        reportTime(tasks, from, to);
+    } else if (command == "agenda") {
+        string from = argc > 2 ? args[2] : today();
+        if (!isDate(from)) {
+            cout << "Dates must be in YYYY-MM-DD format." << endl;
+            return 1;
+        }
+        string to = argc > 3 ? args[3] : dateFromDays(dayNumber(from) + 6);
+        if (!isDate(to)) {
+            cout << "Dates must be in YYYY-MM-DD format." << endl;
+            return 1;
+        }
+        listAgenda(tasks, from, to);
+    } else if (command == "find" && !task.empty()) {
+        vector<FuzzyMatch> matches = fuzzyFind(tasks, task, false, 10);
+        if (matches.empty()) {
+            cout << "No task matches '" << task << "'." << endl;
+            return 1;
+        }
+        for (const FuzzyMatch& match : matches) {
+            printTask(tasks[match.position], match.position + 1);
+        }
+    } else if (command == "ready") {
+        listReady(tasks);
+    } else if (command == "query" && !task.empty()) {
+        if (!queryTasks(tasks, task, explain, bench)) return 1;
+    } else if (command == "search" && !task.empty()) {
+        if (!queryTasks(tasks, searchQuery(task), explain, bench)) return 1;
+    } else if (command == "view") {
+        stringstream words(task);
+        string name, text;
+        words >> name;
+        getline(words, text);
+        text = trim(text);
+        if (name.empty()) {
+            listViews();
+        } else if (name == "save") {
+            stringstream rest(text);
+            rest >> name;
+            getline(rest, text);
+            if (!saveView(tasks, name, trim(text))) return 1;
+        } else if (name == "drop") {
+            SavedView* view = findView(text);
+            if (!view) {
+                cout << "No view named '" << text << "'." << endl;
+                return 1;
+            }
+            savedViews.erase(savedViews.begin() + (view - savedViews.data()));
+            saveViews();
+            cout << "Dropped view '" << text << "'." << endl;
+        } else if (!showView(tasks, name)) {
+            return 1;
+        }
+    } else if (command == "dedupe") {
+        stringstream options(task);
+        string option;
+        bool dryRun = false;
+        double threshold = 0.8;
+        while (options >> option) {
+            if (option == "--dry-run") {
+                dryRun = true;
+            } else if (option == "--threshold" && options >> threshold && threshold > 0 && threshold <= 1) {
+                continue;
+            } else {
+                cout << "Usage: todo dedupe [--dry-run] [--threshold 0.0-1.0]" << endl;
+                return 1;
+            }
+        }
+        size_t removed = dedupeTasks(tasks, threshold, dryRun);
+        if (dryRun) {
+            cout << "Found " << removed << (removed == 1 ? " duplicate." : " duplicates.") << endl;
+        } else {
+            if (removed > 0) saveTasks(tasks);
+            cout << "Removed " << removed << (removed == 1 ? " duplicate." : " duplicates.") << endl;
+        }
+    } else if (command == "cache") {
+        printCacheStats();
+    } else if (command == "reset") {
+        resetTasks(tasks);
+        saveTasks(tasks);
+        cout << "All tasks reset." << endl;
+    } else {
+        cout << "Invalid command." << endl;
+        return 1;
+    }
+
+    return 0;
+}
+
+const std::string HISTORY_FILENAME = getExecutableDirectory() + "\\todo.history"; /**< File path of the shell history */
+
+const size_t HISTORY_LIMIT = 1000;                   /**< The number of shell history lines kept. */
+const chrono::milliseconds SAVE_DELAY(500);          /**< How long the shell waits for further changes before saving. */
+
+/**
+ * @class WriteBehind
+ * @brief Saves the task list of the shell on a background thread.
+ *
+ * Commands only mark the list as changed. The writer thread saves it once no
+ * further change has come in for SAVE_DELAY, so a burst of commands costs one
+ * save. Commands and saves hold the same mutex, so a save never sees a list
+ * in the middle of a change.
+ */
+class WriteBehind {
+public:
+    /**
+     * @brief Starts the writer thread and defers all saves to it.
+     * @param tasks The task list of the shell.
+     * @param lock The mutex held while a command runs.
+     */
+    WriteBehind(const vector<Task>& tasks, mutex& lock) : tasks(tasks), lock(lock), dirty(false), stopping(false) {
+        deferSave = [this] { schedule(); };
+        writer = thread([this] { run(); });
+    }
+
+    /**
+     * @brief Stops the writer thread and saves pending changes.
+     */
+    ~WriteBehind() {
+        {
+            lock_guard<mutex> guard(lock);
+            stopping = true;
+            changed.notify_one();
+        }
+        writer.join();
+        flush();
+        deferSave = nullptr;
+    }
+
+    /**
+     * @brief Saves pending changes now.
+     *
+     * Must be called without holding the mutex.
+     */
+    void flush() {
+        lock_guard<mutex> guard(lock);
+        if (dirty) save();
+    }
+
+private:
+    const vector<Task>& tasks;
+    mutex& lock;
+    condition_variable changed;
+    chrono::steady_clock::time_point due;
+    bool dirty;
+    bool stopping;
+    thread writer;
+
+    // Called by saveTasks() while a command holds the mutex
+    void schedule() {
+        dirty = true;
+        due = chrono::steady_clock::now() + SAVE_DELAY;
+        changed.notify_one();
+    }
+
+    void save() {
+        writeTasks(tasks);
+        dirty = false;
+    }
+
+    void run() {
+        unique_lock<mutex> guard(lock);
+        while (!stopping) {
+            if (!dirty) {
+                changed.wait(guard);
+            } else if (chrono::steady_clock::now() < due) {
+                changed.wait_until(guard, due);  // a new change moves the deadline
+            } else {
+                save();
+            }
+        }
+    }
+};
+
+/**
+ * @brief Splits a shell line into words; double quotes group words.
+ * @param line The line.
+ * @return The words.
+ */
+vector<string> splitShellLine(const string& line) {
+    vector<string> words;
+    string word;
+    bool quoted = false, started = false;
+    for (char c : line) {
+        if (c == '"') {
+            quoted = !quoted;
+            started = true;
+        } else if (isspace(static_cast<unsigned char>(c)) && !quoted) {
+            if (started) words.push_back(word);
+            word.clear();
+            started = false;
+        } else {
+            word += c;
+            started = true;
+        }
+    }
+    if (started) words.push_back(word);
+    return words;
+}
+
+/**
+ * @brief Makes the counts and indexes kept alongside the task file valid.
+ *
+ * Used when several commands run before the list is saved: the loaded list is
+ * current, so the counts and indexes can be made valid now and then follow
+ * every change, even before the first save.
+ * @param tasks The loaded task list.
+ */
+void syncSidecars(const vector<Task>& tasks) {
+    prepareSidecars();
+    if (!taskStats.valid) rebuildStats(tasks);
+    if (!hashIndex.valid) rebuildHashIndex(tasks);
+    if (!completionIndex.valid) rebuildCompletions(tasks);
+}
+
+/**
+ * @brief Runs the interactive shell.
+ *
+ * The list is loaded once and every command works on it in memory; changes
+ * are saved in the background by a WriteBehind and flushed on exit. Lines are
+ * read from the console, which provides line editing and the arrow-key history
+ * of the session. The commands are kept in a history file; `history` lists
+ * them, `!N` repeats command N and `!!` the last one. `save` saves at once.
+ * @param tasks The loaded task list.
+ * @return The exit status.
+ */
+int runShell(vector<Task>& tasks) {
+    vector<string> history;
+    ifstream previous(HISTORY_FILENAME);
+    for (string entry; getline(previous, entry);) {
+        if (!entry.empty()) history.push_back(entry);
+    }
+    previous.close();
+    if (history.size() > HISTORY_LIMIT) history.erase(history.begin(), history.end() - HISTORY_LIMIT);
+    ofstream historyFile(HISTORY_FILENAME);
+    for (const string& entry : history) historyFile << entry << "\n";
+
+    syncSidecars(tasks);
+    residentSession = true;
+
+    mutex lock;
+    WriteBehind writer(tasks, lock);
+    bool prompt = outputFormat == OutputFormat::Text;
+    if (prompt) cout << "Type a command, 'history' or 'exit'." << endl;
+    string line;
+    while (true) {
+        if (prompt) cout << "todo> ";
+        output.flush();
+        if (!getline(cin, line)) break;
+        line = trim(line);
+        if (line.empty()) continue;
+        if (line == "exit" || line == "quit") break;
+        if (line == "history") {
+            for (size_t i = 0; i < history.size(); ++i) cout << setw(5) << i + 1 << "  " << history[i] << endl;
+            continue;
+        }
+        if (line[0] == '!') {
+            size_t n = line == "!!" ? history.size() : static_cast<size_t>(atoi(line.c_str() + 1));
+            if (n == 0 || n > history.size()) {
+                cout << "No command " << line << " in the history." << endl;
+                continue;
+            }
+            line = history[n - 1];
+            cout << line << endl;
+        }
+        history.push_back(line);
+        historyFile << line << "\n" << flush;
+
+        vector<string> args = splitShellLine(line);
+        args.insert(args.begin(), "todo");
+        if (args[1] == "save") {
+            writer.flush();
+            cout << "Saved." << endl;
+        } else if (args[1] == "shell") {
+            cout << "Already in the shell." << endl;
+        } else if (isFileCommand(args)) {
+            writer.flush();  // these commands read the files
+            lock_guard<mutex> guard(lock);
+            runFileCommand(args);
+            if (args[1] == "import" || args[1] == "merge") {
+                loadTasksFromFile(tasks);  // the task file may have changed
+                hashIndex = HashIndex();
+                completionIndex = CompletionIndex();
+                trigramIndex = TrigramIndex();
+                syncSidecars(tasks);
+            }
+        } else {
+            lock_guard<mutex> guard(lock);
+            try {
+                runCommand(tasks, args);
+            } catch (const exception&) {
+                cout << "Invalid command." << endl;
+            }
+        }
+    }
+    if (prompt) cout << endl;
+    lock_guard<mutex> guard(lock);
+    if (cacheChanged) saveCache();  // results cached without a change to the list
+    residentSession = false;
+    return 0;
+}
+
+/**
+ * @brief Tells whether a command can run in a batch.
+ * @param command The command name.
+ * @return true for commands that change the list only through saveTasks(), and for listings.
+ */
+bool isBatchCommand(const string& command) {
+    static const vector<string> commands = {"add", "subtask", "remove", "done", "block", "unblock", "start", "stop", "dedupe", "reset",
+                                            "list", "find", "ready", "query", "search", "agenda"};
+    return find(commands.begin(), commands.end(), command) != commands.end();
+}
+
+/**
+ * @brief Runs the commands of a batch file as one transaction.
+ *
+ * Every line holds one command as typed in `todo shell`; empty lines and lines
+ * starting with `#` are skipped. The commands work on the list in memory and
+ * their saves are held back. If a command fails, the batch stops and nothing
+ * is written. Otherwise the list is committed once with commitTasks() and the
+ * changes are appended to the event journal as one group.
+ * @param tasks The loaded task list.
+ * @param path The batch file, or `-` for the standard input.
+ * @return The exit status.
+ */
+int runBatch(vector<Task>& tasks, const string& path) {
+    ifstream file;
+    if (path != "-") {
+        file.open(path);
+        if (!file.is_open()) {
+            cout << "Cannot read '" << path << "'." << endl;
+            return 1;
+        }
+    }
+    istream& in = path == "-" ? cin : file;
+
+    syncSidecars(tasks);
+    bool changed = false;
+    deferSave = [&changed] { changed = true; };
+    size_t number = 0, commands = 0;
+    for (string line; getline(in, line);) {
+        ++number;
+        line = trim(line);
+        if (line.empty() || line[0] == '#') continue;
+        vector<string> args = splitShellLine(line);
+        args.insert(args.begin(), "todo");
+        int status = 1;
+        if (!isBatchCommand(args[1])) {
+            cout << "'" << args[1] << "' cannot run in a batch." << endl;
+        } else {
+            try {
+                status = runCommand(tasks, args);
+            } catch (const exception&) {
+                cout << "Invalid command." << endl;
+            }
+        }
+        if (status != 0) {
+            cout << "Batch aborted at line " << number << "; no changes were saved." << endl;
+            return 1;
+        }
+        ++commands;
+    }
+    deferSave = nullptr;
+
+    if (changed) {
+        pendingEvents.insert(pendingEvents.begin(), {"batch", 0, "", static_cast<long long>(pendingEvents.size())});
+        if (!commitTasks(tasks)) return 1;
+    }
+    cout << "Committed " << commands << (commands == 1 ? " command." : " commands.") << endl;
+    return 0;
+}
+
+/**
+ * @brief Main entry point of the ToDo application.
+ *
+ * Handles command-line arguments to execute the appropriate task-related functions.
+ * @param argc The number of command-line arguments.
+ * @param argv The array of command-line arguments.
+ * @return An integer status code (1 for invalid input, 0 for success).
+ */
+int main(int argc, char* argv[]) {
+    vector<Task> tasks;
+
+    // Output options may appear anywhere and apply to every command
+    OutputFormat format = OutputFormat::Text;
+    vector<string> args;
+    for (int i = 0; i < argc; ++i) {
+        string arg = argv[i];
+        if (arg == "--json") {
+            format = OutputFormat::Json;
+        } else if (arg == "--ndjson") {
+            format = OutputFormat::Ndjson;
+        } else if ((arg == "-l" || arg == "--list") && i + 1 < argc) {
+            if (!selectList(argv[++i])) return 1;
+        } else {
+            args.push_back(arg);
+        }
+    }
+    argc = static_cast<int>(args.size());
+    if (argc >= 2 && (args[1] == "export" || args[1] == "events")) format = OutputFormat::Text;  // they write their own format
+    OutputSession session(format);
+
+    int status = runFileCommand(args);
+    if (status >= 0) return status;
+
+    // Load tasks from the file at the beginning
+    loadTasksFromFile(tasks);
+    loadViews();
+
+    if (argc < 2) {
+        cout << "Usage: todo [COMMAND] [ARGUMENTS]" << endl;
+        return 1;
+    }
+    if (args[1] == "shell") return runShell(tasks);
+    if (args[1] == "batch") {
+        if (argc != 3) {
+            cout << "Usage: todo batch FILE" << endl;
+            return 1;
+        }
+        return runBatch(tasks, args[2]);
+    }
+    return runCommand(tasks, args);
 }